@@ -0,0 +1,55 @@
+/**
+ * @file Arduino.h
+ * @brief The part of the Arduino core the host build needs
+ *
+ * Time comes from a clock the tests and the simulator set and advance
+ * themselves, so timing-dependent code runs the same on every machine.
+ */
+
+#pragma once
+
+#include "Print.h"
+#include "WString.h"
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using std::max;
+using std::min;
+
+/// Host clock in microseconds since start; nothing advances it but the caller
+extern uint64_t hostClockUs;
+
+inline uint32_t millis()
+{
+    return (uint32_t)(hostClockUs / 1000);
+}
+
+inline uint32_t micros()
+{
+    return (uint32_t)hostClockUs;
+}
+
+/// Run after every delay(), so a simulator can do what the rest of the firmware
+/// would have done while the caller was blocked
+extern void (*hostDelayHook)();
+
+/// Arduino's delay() blocks; here it just moves the clock on
+inline void delay(uint32_t ms)
+{
+    hostClockUs += (uint64_t)ms * 1000;
+    if (hostDelayHook) {
+        hostDelayHook();
+    }
+}
+
+inline void hostSetMillis(uint32_t ms)
+{
+    hostClockUs = (uint64_t)ms * 1000;
+}
+
+/// Arduino's random(): 0 to howbig - 1, from a generator randomSeed() restarts
+long random(long howbig);
+void randomSeed(unsigned long seed);
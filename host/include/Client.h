@@ -0,0 +1,21 @@
+/**
+ * @file Client.h
+ * @brief Arduino's Client interface, as the gateway's HTTP code uses it
+ */
+
+#pragma once
+
+#include "Print.h"
+
+class Client : public Print
+{
+  public:
+    virtual int connect(const char *host, uint16_t port) = 0;
+    virtual size_t write(uint8_t c) override = 0;
+    virtual size_t write(const uint8_t *data, size_t len) override = 0;
+    virtual int available() = 0;
+    virtual int read(uint8_t *buf, size_t size) = 0;
+    virtual void flush() override {}
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+};
@@ -0,0 +1,23 @@
+/**
+ * @file ErriezCRC32.h
+ * @brief The ErriezCRC32 API (CRC-32, polynomial 0xEDB88320) for the host build
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC32_INITIAL 0xFFFFFFFFUL
+
+uint32_t crc32Update(const void *buffer, size_t length, uint32_t crc);
+
+inline uint32_t crc32Final(uint32_t crc)
+{
+    return ~crc;
+}
+
+inline uint32_t crc32Buffer(const void *buffer, size_t length)
+{
+    return crc32Final(crc32Update(buffer, length, CRC32_INITIAL));
+}
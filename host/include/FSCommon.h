@@ -0,0 +1,58 @@
+/**
+ * @file FSCommon.h
+ * @brief An in-memory FSCom for the host build
+ *
+ * Files live in hostFiles, keyed by path, so tests can inspect, corrupt or
+ * truncate them. hostWriteBudget simulates a power cut: once that many more
+ * bytes have been written, every further write comes up short.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WString.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define FILE_O_READ "r"
+#define FILE_O_WRITE "w"
+#define FILE_APPEND "a"
+
+extern std::map<std::string, std::vector<uint8_t>> hostFiles;
+extern long hostWriteBudget; // Bytes that may still be written, -1 for no limit
+extern uint32_t hostFileOpens; // Opens for writing, to count flash writes
+
+class File
+{
+  public:
+    File() = default;
+    explicit File(std::vector<uint8_t> *data) : _data(data) {}
+
+    explicit operator bool() const { return _data != nullptr; }
+
+    int read(uint8_t *buf, size_t len);
+    int read(char *buf, size_t len) { return read((uint8_t *)buf, len); }
+    size_t write(const uint8_t *buf, size_t len);
+    size_t write(const char *buf, size_t len) { return write((const uint8_t *)buf, len); }
+    bool seek(size_t pos);
+    size_t size() const { return _data ? _data->size() : 0; }
+    String readString();
+    void close() { _data = nullptr; }
+
+  private:
+    std::vector<uint8_t> *_data = nullptr;
+    size_t _pos = 0;
+};
+
+class HostFS
+{
+  public:
+    File open(const char *path, const char *mode);
+    bool exists(const char *path) const { return hostFiles.count(path) > 0; }
+    bool remove(const char *path) { return hostFiles.erase(path) > 0; }
+    bool mkdir(const char *) { return true; }
+};
+
+extern HostFS FSCom;
+#define FSCom FSCom
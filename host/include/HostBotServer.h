@@ -0,0 +1,116 @@
+/**
+ * @file HostBotServer.h
+ * @brief A stand-in for api.telegram.org on the host clock
+ *
+ * Connections speak the part of HTTP/1.1 the gateway uses: keep-alive, and a
+ * Content-Length on every reply. sendMessage, sendLocation and
+ * editMessageLiveLocation are answered ok with a message_id, unless the chat
+ * is over Telegram's per-minute limit; that gets a 429 with retry_after, as
+ * the real API does. getUpdates long polls: it is answered as soon as a chat
+ * user has sent something, or empty once its timeout has passed.
+ *
+ * A reply becomes readable rttMs after the request was written, and
+ * connect() spends a TLS handshake's worth of delay(), so the time the
+ * gateway spends blocked is what it would be on a real link.
+ */
+
+#pragma once
+
+#include <Client.h>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+struct HostBotConfig {
+    uint32_t rttMs = 150;       // Request written -> reply readable
+    uint32_t handshakeMs = 900; // Spent in connect()
+    uint16_t perMinute = 20;    // Sends Telegram takes per chat in any minute, 0 = no limit
+    uint8_t dropPercent = 0;    // Requests whose connection dies before there is a reply
+    uint32_t seed = 1;
+};
+
+struct HostBotStats {
+    uint32_t connects;
+    uint32_t accepted; // Sends answered ok
+    uint32_t limited;  // Sends answered 429
+    uint32_t dropped;  // Connections killed mid-request
+    uint32_t polls;    // getUpdates answered
+};
+
+/// A send the server answered ok
+struct HostBotRequest {
+    uint32_t at; // millis() when the request was complete
+    std::string method;
+    std::string body; // The JSON payload as sent
+};
+
+class HostBotServer
+{
+  public:
+    /// One client connection to the server
+    class Connection : public Client
+    {
+      public:
+        explicit Connection(HostBotServer &server) : _server(server) {}
+
+        int connect(const char *host, uint16_t port) override;
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *data, size_t len) override;
+        int available() override;
+        int read(uint8_t *buf, size_t size) override;
+        void stop() override;
+        uint8_t connected() override { return _open; }
+
+      private:
+        friend class HostBotServer;
+
+        HostBotServer &_server;
+        bool _open = false;
+        std::string _request; // Bytes of the request being written
+        std::string _reply;
+        size_t _replyPos = 0;
+        uint32_t _replyAt = 0; // millis() from which _reply can be read
+
+        // A getUpdates the server is holding
+        bool _polling = false;
+        int32_t _pollOffset = 0;
+        uint32_t _pollLimit = 0;
+        uint32_t _pollSince = 0;
+        uint32_t _pollUntil = 0;
+    };
+
+    explicit HostBotServer(const HostBotConfig &config = HostBotConfig());
+
+    /// A user in chatId sends text to the bot now; the next getUpdates returns it
+    void userSends(const char *chatId, const char *text);
+
+    /// Updates no getUpdates offset has confirmed yet
+    size_t unconfirmed() const { return _updates.size(); }
+
+    const std::vector<HostBotRequest> &accepted() const { return _accepted; }
+    const HostBotStats &stats() const { return _stats; }
+
+  private:
+    struct Update {
+        int32_t id;
+        uint32_t sentAt;
+        std::string chatId;
+        std::string text;
+    };
+
+    void handle(Connection &conn, const std::string &request);
+    void handleSend(Connection &conn, const std::string &method, const std::string &body);
+    bool answerPoll(Connection &conn);
+    void reply(Connection &conn, int status, const std::string &body, uint32_t at);
+
+    HostBotConfig _config;
+    std::mt19937 _random;
+    std::deque<Update> _updates;
+    int32_t _nextUpdateId = 1000;
+    int32_t _nextMessageId = 1;
+    std::map<std::string, std::deque<uint32_t>> _sendTimes; // Per chat, the last minute's accepted sends
+    std::vector<HostBotRequest> _accepted;
+    HostBotStats _stats = {};
+};
@@ -0,0 +1,50 @@
+/**
+ * @file HostHeap.h
+ * @brief A model of the ESP32's internal heap for the host build
+ *
+ * heap_caps_* allocate from hostHeap when a test has set one up, so the free
+ * bytes and the largest free block they report move the way they do on the
+ * device. Like ESP-IDF's multi_heap it takes the best fitting free block,
+ * puts an 8-byte header in front of every allocation and merges a freed
+ * block with free neighbours. Without a hostHeap they fall back to malloc
+ * and report a heap with room to spare.
+ */
+
+#pragma once
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class HostHeap
+{
+  public:
+    explicit HostHeap(size_t bytes);
+
+    void *alloc(size_t bytes);
+    /// Grows in place when the next block is free, as multi_heap does; nullptr and ptr kept if it can't
+    void *realloc(void *ptr, size_t bytes);
+    void free(void *ptr);
+    bool owns(const void *ptr) const;
+
+    size_t freeBytes() const { return _freeBytes; }
+    /// Bytes the largest free block can hold
+    size_t largestFree() const;
+
+  private:
+    static const size_t HEADER = 8;
+    static const size_t MIN_SPLIT = 16; // A remainder smaller than this stays with the allocation
+
+    static size_t blockSize(size_t bytes) { return ((bytes + 3) & ~(size_t)3) + HEADER; }
+    void addFree(size_t offset, size_t size);
+    void removeFree(std::map<size_t, size_t>::iterator it);
+
+    std::vector<uint8_t> _arena;
+    std::map<size_t, size_t> _free;           // Offset -> block size, header included
+    std::multimap<size_t, size_t> _freeSizes; // Block size -> offset, for best fit
+    std::map<size_t, size_t> _used;
+    size_t _freeBytes;
+};
+
+extern HostHeap *hostHeap;
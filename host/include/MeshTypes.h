@@ -0,0 +1,13 @@
+/**
+ * @file MeshTypes.h
+ * @brief The Meshtastic mesh types the host build needs
+ */
+
+#pragma once
+
+#include "mesh/generated/meshtastic/mesh.pb.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t NodeNum;
+typedef uint32_t PacketId; // A packet sequence number
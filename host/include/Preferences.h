@@ -0,0 +1,40 @@
+/**
+ * @file Preferences.h
+ * @brief ESP32 NVS preferences for the host build
+ *
+ * Values live in hostPreferences, keyed by "namespace/key", so tests can
+ * set what a module reads at boot.
+ */
+
+#pragma once
+
+#include <WString.h>
+#include <map>
+#include <string>
+
+extern std::map<std::string, std::string> hostPreferences;
+
+class Preferences
+{
+  public:
+    bool begin(const char *name, bool readOnly = false)
+    {
+        _name = name;
+        return true;
+    }
+    void end() { _name.clear(); }
+
+    String getString(const char *key, const String &defaultValue = String())
+    {
+        auto it = hostPreferences.find(_name + "/" + key);
+        return it == hostPreferences.end() ? defaultValue : String(it->second);
+    }
+    size_t putString(const char *key, const String &value)
+    {
+        hostPreferences[_name + "/" + key] = value.c_str();
+        return value.length();
+    }
+
+  private:
+    std::string _name;
+};
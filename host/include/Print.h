@@ -0,0 +1,43 @@
+/**
+ * @file Print.h
+ * @brief Arduino's Print, with the overloads the gateway uses
+ */
+
+#pragma once
+
+#include "WString.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+class Print
+{
+  public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *data, size_t len)
+    {
+        size_t written = 0;
+        while (written < len && write(data[written]) == 1) {
+            written++;
+        }
+        return written;
+    }
+    virtual void flush() {}
+
+    size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t print(const String &text) { return write((const uint8_t *)text.c_str(), text.length()); }
+    size_t print(long value)
+    {
+        char digits[24];
+        return write((const uint8_t *)digits, snprintf(digits, sizeof(digits), "%ld", value));
+    }
+    size_t print(unsigned long value)
+    {
+        char digits[24];
+        return write((const uint8_t *)digits, snprintf(digits, sizeof(digits), "%lu", value));
+    }
+    size_t print(int value) { return print((long)value); }
+    size_t print(unsigned int value) { return print((unsigned long)value); }
+};
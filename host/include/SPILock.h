@@ -0,0 +1,10 @@
+/**
+ * @file SPILock.h
+ * @brief The lock Meshtastic holds around flash and radio SPI access
+ */
+
+#pragma once
+
+#include "concurrency/LockGuard.h"
+
+extern concurrency::Lock *spiLock;
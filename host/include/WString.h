@@ -0,0 +1,29 @@
+/**
+ * @file WString.h
+ * @brief Arduino's String, on std::string, with the members the gateway uses
+ */
+
+#pragma once
+
+#include <string>
+
+class String
+{
+  public:
+    String() = default;
+    String(const char *text) : _text(text ? text : "") {}
+    String(const std::string &text) : _text(text) {}
+
+    const char *c_str() const { return _text.c_str(); }
+    unsigned int length() const { return _text.length(); }
+    bool isEmpty() const { return _text.empty(); }
+    String &operator+=(const String &other)
+    {
+        _text += other._text;
+        return *this;
+    }
+    bool operator==(const char *other) const { return _text == other; }
+
+  private:
+    std::string _text;
+};
@@ -0,0 +1,87 @@
+/**
+ * @file WiFi.h
+ * @brief The ESP32 WiFi station API on a scripted access point
+ *
+ * Tests describe the access point in WiFi.ap: whether it is there, how long
+ * association takes, and whether it refuses the password or never hands out
+ * an address. begin() starts an attempt whose outcome status() reports once
+ * that much host time has passed. As on the ESP32, status() keeps reporting
+ * the previous attempt for a moment after begin(), and events are delivered
+ * on their own task: here, whenever the test calls WiFi.deliverEvents().
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_STA_START = 2,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP = 8
+} WiFiEvent_t;
+
+typedef struct {
+} WiFiEventInfo_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1 } wifi_mode_t;
+
+class IPAddress
+{
+  public:
+    String toString() const { return "192.168.4.20"; }
+};
+
+struct HostAccessPoint {
+    bool present = true;
+    uint32_t associateMs = 3000; // begin() -> outcome
+    bool refuses = false;        // Wrong password: WL_CONNECT_FAILED
+    bool dhcpStalls = false;     // Associates, but never gets an address
+};
+
+class HostWiFi
+{
+  public:
+    void onEvent(std::function<void(WiFiEvent_t, WiFiEventInfo_t)> handler) { _handlers.push_back(handler); }
+    bool mode(wifi_mode_t) { return true; }
+    bool setAutoReconnect(bool) { return true; }
+    wl_status_t begin(const char *ssid, const char *password);
+    bool disconnect();
+    wl_status_t status();
+    IPAddress localIP() const { return IPAddress(); }
+
+    /// Run the event task: hand queued events to the onEvent() handlers
+    void deliverEvents();
+    /// The access point goes away under an established link
+    void dropLink();
+    /// Back to power-on, handlers included
+    void reset() { *this = HostWiFi(); }
+
+    HostAccessPoint ap;
+    std::vector<uint32_t> begins; // millis() of every begin()
+
+  private:
+    void update();
+
+    std::vector<std::function<void(WiFiEvent_t, WiFiEventInfo_t)>> _handlers;
+    std::deque<WiFiEvent_t> _events;
+    wl_status_t _status = WL_IDLE_STATUS;
+    bool _attempting = false;
+    uint32_t _beganAt = 0;
+};
+
+extern HostWiFi WiFi;
@@ -0,0 +1,23 @@
+/**
+ * @file Lock.h
+ * @brief Meshtastic's concurrency::Lock on a std::mutex
+ */
+
+#pragma once
+
+#include <mutex>
+
+namespace concurrency
+{
+
+class Lock
+{
+  public:
+    void lock() { _mutex.lock(); }
+    void unlock() { _mutex.unlock(); }
+
+  private:
+    std::mutex _mutex;
+};
+
+} // namespace concurrency
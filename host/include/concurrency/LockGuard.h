@@ -0,0 +1,26 @@
+/**
+ * @file LockGuard.h
+ * @brief Meshtastic's scoped concurrency::LockGuard
+ */
+
+#pragma once
+
+#include "Lock.h"
+
+namespace concurrency
+{
+
+class LockGuard
+{
+  public:
+    explicit LockGuard(Lock *lock) : _lock(lock) { _lock->lock(); }
+    ~LockGuard() { _lock->unlock(); }
+
+    LockGuard(const LockGuard &) = delete;
+    LockGuard &operator=(const LockGuard &) = delete;
+
+  private:
+    Lock *_lock;
+};
+
+} // namespace concurrency
@@ -0,0 +1,18 @@
+/**
+ * @file configuration.h
+ * @brief Meshtastic's logging macros for the host build
+ *
+ * Log lines are dropped unless HOST_LOG is set in the environment, so test
+ * output stays readable; run with HOST_LOG=1 to see them.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+void hostLog(const char *level, const char *format, ...);
+
+#define LOG_DEBUG(...) hostLog("DEBUG", __VA_ARGS__)
+#define LOG_INFO(...) hostLog("INFO", __VA_ARGS__)
+#define LOG_WARN(...) hostLog("WARN", __VA_ARGS__)
+#define LOG_ERROR(...) hostLog("ERROR", __VA_ARGS__)
@@ -0,0 +1,14 @@
+/**
+ * @file FreeRTOS.h
+ * @brief The FreeRTOS critical sections the gateway uses, on a std::mutex
+ */
+
+#pragma once
+
+#include <mutex>
+
+typedef std::mutex portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->lock()
+#define portEXIT_CRITICAL(mux) (mux)->unlock()
@@ -0,0 +1,23 @@
+/**
+ * @file platform.h
+ * @brief mbedTLS's allocation hook for the host build
+ *
+ * There is no mbedTLS here; the hook is only recorded, so tests can stand in
+ * for its allocations by calling hostMbedtlsCalloc and hostMbedtlsFree.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#define MBEDTLS_PLATFORM_MEMORY
+
+extern void *(*hostMbedtlsCalloc)(size_t count, size_t size);
+extern void (*hostMbedtlsFree)(void *ptr);
+
+inline int mbedtls_platform_set_calloc_free(void *(*callocFunc)(size_t, size_t), void (*freeFunc)(void *))
+{
+    hostMbedtlsCalloc = callocFunc;
+    hostMbedtlsFree = freeFunc;
+    return 0;
+}
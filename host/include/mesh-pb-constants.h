@@ -0,0 +1,65 @@
+/**
+ * @file mesh-pb-constants.h
+ * @brief NodeDB limits and a NodeInfoLite with the fields the host build uses
+ *
+ * Field names and sizes follow meshtastic/deviceonly.pb.h, so code written
+ * against the generated struct compiles unchanged.
+ */
+
+#pragma once
+
+#include "MeshTypes.h"
+#include "pb.h"
+
+#ifndef MAX_NUM_NODES
+#define MAX_NUM_NODES 20 // The gateway variant's value
+#endif
+
+#define NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK (1 << 0)
+
+typedef struct {
+    size_t size;
+    uint8_t bytes[32];
+} meshtastic_UserLite_public_key_t;
+
+typedef struct {
+    char long_name[40];
+    char short_name[5];
+    uint8_t macaddr[6];
+    meshtastic_UserLite_public_key_t public_key;
+} meshtastic_UserLite;
+
+typedef struct {
+    int32_t latitude_i;
+    int32_t longitude_i;
+    int32_t altitude;
+    uint32_t time;
+} meshtastic_PositionLite;
+
+typedef struct {
+    NodeNum num;
+    bool has_user;
+    meshtastic_UserLite user;
+    bool has_position;
+    meshtastic_PositionLite position;
+    float snr;
+    uint32_t last_heard;
+    uint8_t channel;
+    bool via_mqtt;
+    uint8_t hops_away;
+    bool is_favorite;
+    bool is_ignored;
+    uint32_t bitfield;
+} meshtastic_NodeInfoLite;
+
+#define meshtastic_NodeInfoLite_size sizeof(meshtastic_NodeInfoLite)
+extern const pb_msgdesc_t meshtastic_NodeInfoLite_msg;
+
+/// Encode src into destbuf, returning the encoded length (0 on failure)
+size_t pb_encode_to_bytes(uint8_t *destbuf, size_t destbufsize, const pb_msgdesc_t *fields, const void *src_struct);
+
+/// Decode srcbuf into dest_struct, false if it does not decode
+bool pb_decode_from_bytes(const uint8_t *srcbuf, size_t srcbufsize, const pb_msgdesc_t *fields, void *dest_struct);
+
+/// Calls of pb_decode_from_bytes() so far, for tests counting decodes
+extern uint32_t hostPbDecodes;
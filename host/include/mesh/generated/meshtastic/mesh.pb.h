@@ -0,0 +1,69 @@
+/**
+ * @file mesh.pb.h
+ * @brief MeshPacket, Data and Position with the fields the host build uses
+ *
+ * Field names and sizes follow meshtastic/mesh.pb.h, so code written against
+ * the generated structs compiles unchanged.
+ */
+
+#pragma once
+
+#include "mesh/generated/meshtastic/portnums.pb.h"
+#include <pb.h>
+
+typedef struct _meshtastic_Position {
+    bool has_latitude_i;
+    int32_t latitude_i;
+    bool has_longitude_i;
+    int32_t longitude_i;
+    bool has_altitude;
+    int32_t altitude;
+    uint32_t time;
+    uint32_t ground_speed;
+    uint32_t sats_in_view;
+    uint32_t precision_bits;
+} meshtastic_Position;
+
+typedef struct {
+    pb_size_t size;
+    uint8_t bytes[233];
+} meshtastic_Data_payload_t;
+
+typedef struct _meshtastic_Data {
+    meshtastic_PortNum portnum;
+    meshtastic_Data_payload_t payload;
+    bool want_response;
+    uint32_t dest;
+    uint32_t source;
+    uint32_t request_id;
+    uint32_t reply_id;
+} meshtastic_Data;
+
+typedef struct {
+    pb_size_t size;
+    uint8_t bytes[256];
+} meshtastic_MeshPacket_encrypted_t;
+
+typedef struct _meshtastic_MeshPacket {
+    uint32_t from;
+    uint32_t to;
+    uint8_t channel;
+    pb_size_t which_payload_variant;
+    union {
+        meshtastic_Data decoded;
+        meshtastic_MeshPacket_encrypted_t encrypted;
+    };
+    uint32_t id;
+    uint32_t rx_time;
+    float rx_snr;
+    uint8_t hop_limit;
+    bool want_ack;
+    int32_t rx_rssi;
+    uint8_t hop_start;
+} meshtastic_MeshPacket;
+
+#define meshtastic_Position_init_zero {}
+#define meshtastic_MeshPacket_decoded_tag 4
+#define meshtastic_MeshPacket_encrypted_tag 5
+
+extern const pb_msgdesc_t meshtastic_Position_msg;
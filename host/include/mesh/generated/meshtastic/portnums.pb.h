@@ -0,0 +1,37 @@
+/**
+ * @file portnums.pb.h
+ * @brief The meshtastic_PortNum values the host build uses, numbered as in the generated header
+ */
+
+#pragma once
+
+typedef enum _meshtastic_PortNum {
+    meshtastic_PortNum_UNKNOWN_APP = 0,
+    meshtastic_PortNum_TEXT_MESSAGE_APP = 1,
+    meshtastic_PortNum_REMOTE_HARDWARE_APP = 2,
+    meshtastic_PortNum_POSITION_APP = 3,
+    meshtastic_PortNum_NODEINFO_APP = 4,
+    meshtastic_PortNum_ROUTING_APP = 5,
+    meshtastic_PortNum_ADMIN_APP = 6,
+    meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP = 7,
+    meshtastic_PortNum_WAYPOINT_APP = 8,
+    meshtastic_PortNum_AUDIO_APP = 9,
+    meshtastic_PortNum_DETECTION_SENSOR_APP = 10,
+    meshtastic_PortNum_REPLY_APP = 32,
+    meshtastic_PortNum_IP_TUNNEL_APP = 33,
+    meshtastic_PortNum_PAXCOUNTER_APP = 34,
+    meshtastic_PortNum_SERIAL_APP = 64,
+    meshtastic_PortNum_STORE_FORWARD_APP = 65,
+    meshtastic_PortNum_RANGE_TEST_APP = 66,
+    meshtastic_PortNum_TELEMETRY_APP = 67,
+    meshtastic_PortNum_ZPS_APP = 68,
+    meshtastic_PortNum_SIMULATOR_APP = 69,
+    meshtastic_PortNum_TRACEROUTE_APP = 70,
+    meshtastic_PortNum_NEIGHBORINFO_APP = 71,
+    meshtastic_PortNum_ATAK_PLUGIN = 72,
+    meshtastic_PortNum_MAP_REPORT_APP = 73,
+    meshtastic_PortNum_POWERSTRESS_APP = 74,
+    meshtastic_PortNum_PRIVATE_APP = 256,
+    meshtastic_PortNum_ATAK_FORWARDER = 257,
+    meshtastic_PortNum_MAX = 511
+} meshtastic_PortNum;
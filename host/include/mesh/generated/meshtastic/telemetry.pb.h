@@ -0,0 +1,63 @@
+/**
+ * @file telemetry.pb.h
+ * @brief The telemetry messages the gateway reads, with the generated names
+ */
+
+#pragma once
+
+#include <pb.h>
+#include <stdint.h>
+
+typedef struct _meshtastic_DeviceMetrics {
+    bool has_battery_level;
+    uint32_t battery_level;
+    bool has_voltage;
+    float voltage;
+    bool has_channel_utilization;
+    float channel_utilization;
+    bool has_air_util_tx;
+    float air_util_tx;
+    bool has_uptime_seconds;
+    uint32_t uptime_seconds;
+} meshtastic_DeviceMetrics;
+
+typedef struct _meshtastic_EnvironmentMetrics {
+    bool has_temperature;
+    float temperature;
+    bool has_relative_humidity;
+    float relative_humidity;
+    bool has_barometric_pressure;
+    float barometric_pressure;
+} meshtastic_EnvironmentMetrics;
+
+typedef struct _meshtastic_PowerMetrics {
+    bool has_ch1_voltage;
+    float ch1_voltage;
+    bool has_ch1_current;
+    float ch1_current;
+} meshtastic_PowerMetrics;
+
+typedef struct _meshtastic_AirQualityMetrics {
+    bool has_pm25_standard;
+    uint32_t pm25_standard;
+} meshtastic_AirQualityMetrics;
+
+typedef struct _meshtastic_Telemetry {
+    uint32_t time;
+    pb_size_t which_variant;
+    union {
+        meshtastic_DeviceMetrics device_metrics;
+        meshtastic_EnvironmentMetrics environment_metrics;
+        meshtastic_AirQualityMetrics air_quality_metrics;
+        meshtastic_PowerMetrics power_metrics;
+    } variant;
+} meshtastic_Telemetry;
+
+#define meshtastic_Telemetry_device_metrics_tag 2
+#define meshtastic_Telemetry_environment_metrics_tag 3
+#define meshtastic_Telemetry_air_quality_metrics_tag 4
+#define meshtastic_Telemetry_power_metrics_tag 5
+
+#define meshtastic_Telemetry_init_zero {}
+
+extern const pb_msgdesc_t meshtastic_Telemetry_msg;
@@ -0,0 +1,35 @@
+/**
+ * @file pb.h
+ * @brief A stand-in for nanopb's core types
+ *
+ * The host build has no generated protobuf code. A message descriptor only
+ * records the struct size, and pb_encode()/pb_decode() copy the struct as
+ * it is. That is enough to test code that frames, stores and checks encoded
+ * messages. It does not test the protobuf wire format.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint16_t pb_size_t;
+
+typedef struct {
+    size_t size;
+} pb_msgdesc_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t max_size;
+    size_t bytes_written;
+    const char *errmsg;
+} pb_ostream_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t bytes_left;
+    const char *errmsg;
+} pb_istream_t;
+
+#define PB_GET_ERROR(stream) ((stream)->errmsg ? (stream)->errmsg : "(none)")
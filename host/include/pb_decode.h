@@ -0,0 +1,25 @@
+/**
+ * @file pb_decode.h
+ * @brief nanopb's decoder, as the pb.h stand-in implements it
+ */
+
+#pragma once
+
+#include "pb.h"
+#include <string.h>
+
+inline pb_istream_t pb_istream_from_buffer(const uint8_t *buf, size_t size)
+{
+    return {buf, size, nullptr};
+}
+
+inline bool pb_decode(pb_istream_t *stream, const pb_msgdesc_t *fields, void *dest)
+{
+    if (stream->bytes_left != fields->size) {
+        stream->errmsg = "wrong length";
+        return false;
+    }
+    memcpy(dest, stream->buf, fields->size);
+    stream->bytes_left = 0;
+    return true;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file pb_encode.h
+ * @brief nanopb's encoder, as the pb.h stand-in implements it
+ */
+
+#pragma once
+
+#include "pb.h"
+#include <string.h>
+
+inline pb_ostream_t pb_ostream_from_buffer(uint8_t *buf, size_t size)
+{
+    return {buf, size, 0, nullptr};
+}
+
+inline bool pb_encode(pb_ostream_t *stream, const pb_msgdesc_t *fields, const void *src)
+{
+    if (stream->bytes_written + fields->size > stream->max_size) {
+        stream->errmsg = "stream full";
+        return false;
+    }
+    memcpy(stream->buf + stream->bytes_written, src, fields->size);
+    stream->bytes_written += fields->size;
+    return true;
+}
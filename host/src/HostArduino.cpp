@@ -0,0 +1,42 @@
+/**
+ * @file HostArduino.cpp
+ * @brief State behind the host stand-ins in include/
+ */
+
+#include "Arduino.h"
+#include "configuration.h"
+#include <random>
+#include <stdarg.h>
+
+uint64_t hostClockUs = 0;
+void (*hostDelayHook)() = nullptr;
+
+static std::mt19937 hostRandom;
+
+long random(long howbig)
+{
+    return howbig > 0 ? (long)(hostRandom() % (unsigned long)howbig) : 0;
+}
+
+void randomSeed(unsigned long seed)
+{
+    hostRandom.seed(seed);
+}
+
+void hostLog(const char *level, const char *format, ...)
+{
+    static const bool enabled = getenv("HOST_LOG") != nullptr;
+    if (!enabled) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    printf("%-5s | %07u ", level, millis());
+    vprintf(format, args);
+    va_end(args);
+    // Meshtastic's own LOG_* lines carry no newline, the modules' do
+    size_t len = strlen(format);
+    if (len == 0 || format[len - 1] != '\n') {
+        putchar('\n');
+    }
+}
@@ -0,0 +1,224 @@
+/**
+ * @file HostBotServer.cpp
+ * @brief The host's Telegram Bot API stand-in
+ */
+
+#include "HostBotServer.h"
+#include <Arduino.h>
+
+#define BOT_EPOCH 1700000000UL // Unix time at millis() 0, for message dates
+
+// Value of "key": in a flat JSON object, unquoted; empty if it is not there
+static std::string jsonField(const std::string &json, const char *key)
+{
+    std::string needle = std::string("\"") + key + "\":";
+    size_t at = json.find(needle);
+    if (at == std::string::npos) {
+        return "";
+    }
+    at += needle.size();
+    if (json[at] == '"') {
+        return json.substr(at + 1, json.find('"', at + 1) - at - 1);
+    }
+    return json.substr(at, json.find_first_of(",}", at) - at);
+}
+
+static std::string jsonQuote(const std::string &text)
+{
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Number after "name=" in a query string, fallback if it is not there
+static long queryParam(const std::string &target, const char *name, long fallback)
+{
+    size_t at = target.find(std::string(name) + "=");
+    return at == std::string::npos ? fallback : atol(target.c_str() + at + strlen(name) + 1);
+}
+
+HostBotServer::HostBotServer(const HostBotConfig &config) : _config(config), _random(config.seed) {}
+
+void HostBotServer::userSends(const char *chatId, const char *text)
+{
+    _updates.push_back({_nextUpdateId++, millis(), chatId, text});
+}
+
+void HostBotServer::handle(Connection &conn, const std::string &request)
+{
+    if (_config.dropPercent && _random() % 100 < _config.dropPercent) {
+        _stats.dropped++;
+        conn.stop();
+        return;
+    }
+
+    size_t pathStart = request.find(' ') + 1;
+    std::string target = request.substr(pathStart, request.find(' ', pathStart) - pathStart);
+    size_t methodStart = target.find('/', 1) + 1;
+    std::string method = target.substr(methodStart, target.find('?', methodStart) - methodStart);
+
+    if (method == "getUpdates") {
+        int32_t offset = queryParam(target, "offset", 0);
+        while (!_updates.empty() && _updates.front().id < offset) {
+            _updates.pop_front();
+        }
+        conn._polling = true;
+        conn._pollOffset = offset;
+        conn._pollLimit = queryParam(target, "limit", 100);
+        conn._pollSince = millis();
+        conn._pollUntil = millis() + queryParam(target, "timeout", 0) * 1000;
+        answerPoll(conn);
+    } else if (method == "sendMessage" || method == "sendLocation" || method == "editMessageLiveLocation") {
+        handleSend(conn, method, request.substr(request.find("\r\n\r\n") + 4));
+    } else {
+        reply(conn, 404, "{\"ok\":false,\"error_code\":404,\"description\":\"Not Found\"}", millis() + _config.rttMs);
+    }
+}
+
+void HostBotServer::handleSend(Connection &conn, const std::string &method, const std::string &body)
+{
+    uint32_t now = millis();
+    std::deque<uint32_t> &sent = _sendTimes[jsonField(body, "chat_id")];
+    while (!sent.empty() && now - sent.front() >= 60000) {
+        sent.pop_front();
+    }
+    if (_config.perMinute && sent.size() >= _config.perMinute) {
+        _stats.limited++;
+        uint32_t retryAfter = (sent.front() + 60000 - now + 999) / 1000;
+        char json[160];
+        snprintf(json, sizeof(json),
+                 "{\"ok\":false,\"error_code\":429,\"description\":\"Too Many Requests: retry after %u\","
+                 "\"parameters\":{\"retry_after\":%u}}",
+                 retryAfter, retryAfter);
+        reply(conn, 429, json, now + _config.rttMs);
+        return;
+    }
+
+    sent.push_back(now);
+    _stats.accepted++;
+    _accepted.push_back({now, method, body});
+    int32_t messageId = method == "editMessageLiveLocation" ? atol(jsonField(body, "message_id").c_str())
+                                                             : _nextMessageId++;
+    char json[96];
+    snprintf(json, sizeof(json), "{\"ok\":true,\"result\":{\"message_id\":%d,\"date\":%lu}}", messageId,
+             BOT_EPOCH + now / 1000);
+    reply(conn, 200, json, now + _config.rttMs);
+}
+
+bool HostBotServer::answerPoll(Connection &conn)
+{
+    uint32_t now = millis();
+    std::string result;
+    uint32_t count = 0;
+    uint32_t newest = 0;
+    for (const Update &update : _updates) {
+        if (update.id < conn._pollOffset || count == conn._pollLimit) {
+            continue;
+        }
+        char head[160];
+        snprintf(head, sizeof(head),
+                 "%s{\"update_id\":%d,\"message\":{\"message_id\":%d,\"chat\":{\"id\":%s,\"type\":\"group\"},"
+                 "\"date\":%lu,\"text\":",
+                 count ? "," : "", update.id, update.id, update.chatId.c_str(), BOT_EPOCH + update.sentAt / 1000);
+        result += head + jsonQuote(update.text) + "}}";
+        newest = max(newest, update.sentAt);
+        count++;
+    }
+    if (count == 0 && (int32_t)(now - conn._pollUntil) < 0) {
+        return false;
+    }
+
+    // Updates already waiting go back after a round trip, later ones half a trip after they were sent
+    conn._polling = false;
+    _stats.polls++;
+    uint32_t at = count ? max(conn._pollSince + _config.rttMs, newest + _config.rttMs / 2) : now + _config.rttMs / 2;
+    reply(conn, 200, "{\"ok\":true,\"result\":[" + result + "]}", at);
+    return true;
+}
+
+void HostBotServer::reply(Connection &conn, int status, const std::string &body, uint32_t at)
+{
+    char head[128];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\n\r\n",
+             status, status == 200 ? "OK" : status == 429 ? "Too Many Requests" : "Not Found",
+             (unsigned)body.size());
+    conn._reply.erase(0, conn._replyPos);
+    conn._replyPos = 0;
+    conn._reply += head + body;
+    conn._replyAt = at;
+}
+
+int HostBotServer::Connection::connect(const char *host, uint16_t port)
+{
+    stop();
+    delay(_server._config.handshakeMs);
+    _server._stats.connects++;
+    _open = true;
+    return 1;
+}
+
+size_t HostBotServer::Connection::write(const uint8_t *data, size_t len)
+{
+    if (!_open) {
+        return 0;
+    }
+    _request.append((const char *)data, len);
+
+    size_t headEnd = _request.find("\r\n\r\n");
+    if (headEnd == std::string::npos) {
+        return len;
+    }
+    size_t complete = headEnd + 4;
+    if (_request.compare(0, 5, "POST ") == 0) {
+        size_t cl = _request.find("Content-Length: ");
+        complete += cl < headEnd ? atol(_request.c_str() + cl + 16) : 0;
+    }
+    if (_request.size() >= complete) {
+        std::string request = _request.substr(0, complete);
+        _request.erase(0, complete);
+        _server.handle(*this, request);
+    }
+    return len;
+}
+
+int HostBotServer::Connection::available()
+{
+    if (!_open) {
+        return 0;
+    }
+    if (_polling && !_server.answerPoll(*this)) {
+        return 0;
+    }
+    if ((int32_t)(millis() - _replyAt) < 0) {
+        return 0;
+    }
+    return _reply.size() - _replyPos;
+}
+
+int HostBotServer::Connection::read(uint8_t *buf, size_t size)
+{
+    size_t n = min(size, (size_t)max(available(), 0));
+    memcpy(buf, _reply.data() + _replyPos, n);
+    _replyPos += n;
+    return n;
+}
+
+void HostBotServer::Connection::stop()
+{
+    _open = false;
+    _polling = false;
+    _request.clear();
+    _reply.clear();
+    _replyPos = 0;
+}
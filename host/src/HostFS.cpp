@@ -0,0 +1,91 @@
+/**
+ * @file HostFS.cpp
+ * @brief The in-memory FSCom, NVS preferences, spiLock and CRC-32 of the host build
+ */
+
+#include "ErriezCRC32.h"
+#include "FSCommon.h"
+#include "Preferences.h"
+#include "SPILock.h"
+#include "mesh-pb-constants.h"
+
+std::map<std::string, std::vector<uint8_t>> hostFiles;
+long hostWriteBudget = -1;
+uint32_t hostFileOpens = 0;
+HostFS FSCom;
+std::map<std::string, std::string> hostPreferences;
+
+static concurrency::Lock hostSpiLock;
+concurrency::Lock *spiLock = &hostSpiLock;
+
+const pb_msgdesc_t meshtastic_NodeInfoLite_msg = {sizeof(meshtastic_NodeInfoLite)};
+
+int File::read(uint8_t *buf, size_t len)
+{
+    if (!_data || _pos >= _data->size()) {
+        return 0;
+    }
+    size_t got = min(len, _data->size() - _pos);
+    memcpy(buf, _data->data() + _pos, got);
+    _pos += got;
+    return got;
+}
+
+size_t File::write(const uint8_t *buf, size_t len)
+{
+    if (!_data) {
+        return 0;
+    }
+    if (hostWriteBudget >= 0) {
+        len = min(len, (size_t)hostWriteBudget);
+        hostWriteBudget -= len;
+    }
+    _data->insert(_data->end(), buf, buf + len);
+    return len;
+}
+
+bool File::seek(size_t pos)
+{
+    if (!_data || pos > _data->size()) {
+        return false;
+    }
+    _pos = pos;
+    return true;
+}
+
+String File::readString()
+{
+    std::string text;
+    if (_data && _pos < _data->size()) {
+        text.assign(_data->begin() + _pos, _data->end());
+        _pos = _data->size();
+    }
+    return String(text);
+}
+
+File HostFS::open(const char *path, const char *mode)
+{
+    if (mode[0] == 'r') {
+        auto it = hostFiles.find(path);
+        return it == hostFiles.end() ? File() : File(&it->second);
+    }
+    // Writes always go to the end, as with LittleFS; "w" truncates first
+    std::vector<uint8_t> &data = hostFiles[path];
+    if (mode[0] == 'w') {
+        data.clear();
+    }
+    hostFileOpens++;
+    return File(&data);
+}
+
+uint32_t crc32Update(const void *buffer, size_t length, uint32_t crc)
+{
+    const uint8_t *p = (const uint8_t *)buffer;
+    while (length--) {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file HostHeap.cpp
+ * @brief The modelled ESP32 heap behind heap_caps_*, and the mbedTLS allocation hook
+ */
+
+#include "HostHeap.h"
+#include <esp_heap_caps.h>
+#include <mbedtls/platform.h>
+#include <stdlib.h>
+#include <string.h>
+
+HostHeap *hostHeap = nullptr;
+void *(*hostMbedtlsCalloc)(size_t count, size_t size) = nullptr;
+void (*hostMbedtlsFree)(void *ptr) = nullptr;
+
+HostHeap::HostHeap(size_t bytes) : _arena(bytes), _freeBytes(0)
+{
+    addFree(0, bytes);
+}
+
+void HostHeap::addFree(size_t offset, size_t size)
+{
+    _free[offset] = size;
+    _freeSizes.emplace(size, offset);
+    _freeBytes += size;
+}
+
+void HostHeap::removeFree(std::map<size_t, size_t>::iterator it)
+{
+    auto range = _freeSizes.equal_range(it->second);
+    for (auto s = range.first; s != range.second; ++s) {
+        if (s->second == it->first) {
+            _freeSizes.erase(s);
+            break;
+        }
+    }
+    _freeBytes -= it->second;
+    _free.erase(it);
+}
+
+void *HostHeap::alloc(size_t bytes)
+{
+    size_t want = blockSize(bytes ? bytes : 1);
+    auto best = _freeSizes.lower_bound(want);
+    if (best == _freeSizes.end()) {
+        return nullptr;
+    }
+    size_t offset = best->second;
+    size_t size = best->first;
+    removeFree(_free.find(offset));
+    if (size - want >= MIN_SPLIT) {
+        addFree(offset + want, size - want);
+        size = want;
+    }
+    _used[offset] = size;
+    return _arena.data() + offset + HEADER;
+}
+
+void *HostHeap::realloc(void *ptr, size_t bytes)
+{
+    if (!ptr) {
+        return alloc(bytes);
+    }
+    size_t offset = (uint8_t *)ptr - _arena.data() - HEADER;
+    size_t &size = _used.at(offset);
+    size_t want = blockSize(bytes);
+    if (want <= size) {
+        return ptr;
+    }
+    auto next = _free.find(offset + size);
+    if (next != _free.end() && size + next->second >= want) {
+        size_t total = size + next->second;
+        removeFree(next);
+        size = total - want >= MIN_SPLIT ? want : total;
+        if (size < total) {
+            addFree(offset + size, total - size);
+        }
+        return ptr;
+    }
+    void *moved = alloc(bytes);
+    if (moved) {
+        memcpy(moved, ptr, size - HEADER);
+        free(ptr);
+    }
+    return moved;
+}
+
+void HostHeap::free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    size_t offset = (uint8_t *)ptr - _arena.data() - HEADER;
+    auto used = _used.find(offset);
+    if (used == _used.end()) {
+        abort(); // Not allocated here, or freed twice
+    }
+    size_t size = used->second;
+    _used.erase(used);
+    auto next = _free.find(offset + size);
+    if (next != _free.end()) {
+        size += next->second;
+        removeFree(next);
+    }
+    auto prev = _free.lower_bound(offset);
+    if (prev != _free.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            removeFree(prev);
+        }
+    }
+    addFree(offset, size);
+}
+
+bool HostHeap::owns(const void *ptr) const
+{
+    return ptr >= _arena.data() && ptr < _arena.data() + _arena.size();
+}
+
+size_t HostHeap::largestFree() const
+{
+    return _freeSizes.empty() ? 0 : _freeSizes.rbegin()->first - HEADER;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t)
+{
+    return hostHeap ? hostHeap->alloc(size) : malloc(size);
+}
+
+void *heap_caps_calloc(size_t count, size_t size, uint32_t)
+{
+    if (!hostHeap) {
+        return calloc(count, size);
+    }
+    void *ptr = hostHeap->alloc(count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void heap_caps_free(void *ptr)
+{
+    if (hostHeap && hostHeap->owns(ptr)) {
+        hostHeap->free(ptr);
+    } else {
+        ::free(ptr);
+    }
+}
+
+size_t heap_caps_get_free_size(uint32_t)
+{
+    return hostHeap ? hostHeap->freeBytes() : 200000;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t)
+{
+    return hostHeap ? hostHeap->largestFree() : 110000;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file HostMesh.cpp
+ * @brief Message descriptors and Meshtastic's pb_*_bytes helpers for the host build
+ */
+
+#include "mesh-pb-constants.h"
+#include "mesh/generated/meshtastic/telemetry.pb.h"
+#include <pb_decode.h>
+#include <pb_encode.h>
+
+const pb_msgdesc_t meshtastic_Position_msg = {sizeof(meshtastic_Position)};
+const pb_msgdesc_t meshtastic_Telemetry_msg = {sizeof(meshtastic_Telemetry)};
+
+uint32_t hostPbDecodes = 0;
+
+size_t pb_encode_to_bytes(uint8_t *destbuf, size_t destbufsize, const pb_msgdesc_t *fields, const void *src_struct)
+{
+    pb_ostream_t stream = pb_ostream_from_buffer(destbuf, destbufsize);
+    return pb_encode(&stream, fields, src_struct) ? stream.bytes_written : 0;
+}
+
+bool pb_decode_from_bytes(const uint8_t *srcbuf, size_t srcbufsize, const pb_msgdesc_t *fields, void *dest_struct)
+{
+    hostPbDecodes++;
+    pb_istream_t stream = pb_istream_from_buffer(srcbuf, srcbufsize);
+    return pb_decode(&stream, fields, dest_struct);
+}
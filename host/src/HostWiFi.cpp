@@ -0,0 +1,85 @@
+/**
+ * @file HostWiFi.cpp
+ * @brief The host's scripted WiFi station
+ */
+
+#include "WiFi.h"
+
+#define STALE_STATUS_MS 500 // status() still reports the previous attempt this long after begin()
+
+HostWiFi WiFi;
+
+wl_status_t HostWiFi::begin(const char *ssid, const char *password)
+{
+    begins.push_back(millis());
+    _attempting = true;
+    _beganAt = millis();
+    return _status;
+}
+
+bool HostWiFi::disconnect()
+{
+    // A failed attempt's status stays until the next one reports
+    _attempting = false;
+    if (_status == WL_CONNECTED) {
+        _status = WL_DISCONNECTED;
+        _events.push_back(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    }
+    return true;
+}
+
+wl_status_t HostWiFi::status()
+{
+    update();
+    return _status;
+}
+
+void HostWiFi::update()
+{
+    if (!_attempting) {
+        return;
+    }
+    uint32_t elapsed = millis() - _beganAt;
+    if (elapsed < STALE_STATUS_MS) {
+        return;
+    }
+    if (elapsed < ap.associateMs) {
+        _status = WL_DISCONNECTED;
+        return;
+    }
+    _attempting = false;
+    if (!ap.present) {
+        _status = WL_NO_SSID_AVAIL;
+        _events.push_back(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    } else if (ap.refuses) {
+        _status = WL_CONNECT_FAILED;
+        _events.push_back(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    } else if (ap.dhcpStalls) {
+        _status = WL_DISCONNECTED;
+        _events.push_back(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+    } else {
+        _status = WL_CONNECTED;
+        _events.push_back(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+        _events.push_back(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+}
+
+void HostWiFi::deliverEvents()
+{
+    update();
+    while (!_events.empty()) {
+        WiFiEvent_t event = _events.front();
+        _events.pop_front();
+        for (auto &handler : _handlers) {
+            handler(event, WiFiEventInfo_t());
+        }
+    }
+}
+
+void HostWiFi::dropLink()
+{
+    if (_status == WL_CONNECTED) {
+        _status = WL_CONNECTION_LOST;
+        _events.push_back(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    }
+}
@@ -0,0 +1,84 @@
+"""
+Copy the gateway sources this host build uses into src/gateway, dropping
+the .example suffix. Runs before every build as a PlatformIO pre: script,
+and also on its own: python3 stage_sources.py
+"""
+
+import os
+import shutil
+
+# Host-portable sources, relative to modified_meshtastic_files/src
+SOURCES = [
+    "modules/TelegramOutbox.h",
+    "modules/TelegramOutbox.cpp",
+    "modules/TelegramRateLimiter.h",
+    "modules/TelegramRateLimiter.cpp",
+    "mesh/NodeNumIndex.h",
+    "mesh/NodeNumIndex.cpp",
+    "mesh/NodeEvictionQueue.h",
+    "mesh/NodeEvictionQueue.cpp",
+    "mesh/NodeDBJournal.h",
+    "mesh/NodeDBJournal.cpp",
+    "mesh/PipelineMetrics.h",
+    "mesh/PipelineMetrics.cpp",
+    "modules/TelegramJsonReader.h",
+    "modules/TelegramJsonReader.cpp",
+    "modules/TelegramText.h",
+    "modules/TelegramText.cpp",
+    "modules/TelegramGeo.h",
+    "modules/TelegramGeo.cpp",
+    "modules/TelegramNodeTable.h",
+    "modules/TelegramNodeTable.cpp",
+    "modules/TelegramPoster.h",
+    "modules/TelegramPoster.cpp",
+    "modules/TelegramLongPoller.h",
+    "modules/TelegramLongPoller.cpp",
+    "modules/TelegramMeshQueue.h",
+    "modules/TelegramMeshQueue.cpp",
+    "modules/TelegramLiveLocation.h",
+    "modules/TelegramLiveLocation.cpp",
+    "modules/TelegramTelemetry.h",
+    "modules/TelegramTelemetry.cpp",
+    "modules/TelegramSpscRing.h",
+    "modules/TelegramSpool.h",
+    "modules/TelegramSpool.cpp",
+    "modules/TelegramWiFiLink.h",
+    "modules/TelegramWiFiLink.cpp",
+    "mesh/DecodedPayloads.h",
+    "mesh/DecodedPayloads.cpp",
+    "modules/TelegramRoutes.h",
+    "modules/TelegramRoutes.cpp",
+    "modules/TelegramReplyCache.h",
+    "modules/TelegramReplyCache.cpp",
+    "modules/TelegramHistory.h",
+    "modules/TelegramHistory.cpp",
+    "modules/TelegramMemory.h",
+    "modules/TelegramMemory.cpp",
+]
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.abspath(__file__))
+
+SOURCE_DIR = os.path.join(PROJECT_DIR, "..", "modified_meshtastic_files", "src")
+STAGED_DIR = os.path.join(PROJECT_DIR, "src", "gateway")
+
+
+def stage():
+    os.makedirs(STAGED_DIR, exist_ok=True)
+    wanted = set()
+    for rel in SOURCES:
+        src = os.path.join(SOURCE_DIR, rel + ".example")
+        dst = os.path.join(STAGED_DIR, os.path.basename(rel))
+        wanted.add(os.path.basename(rel))
+        # Only copy what changed, so the build doesn't recompile everything
+        if not os.path.exists(dst) or os.path.getmtime(dst) < os.path.getmtime(src):
+            shutil.copy2(src, dst)
+    for name in os.listdir(STAGED_DIR):
+        if name not in wanted:
+            os.remove(os.path.join(STAGED_DIR, name))
+
+
+stage()
@@ -0,0 +1,287 @@
+// DecodedPayloads: each packet's Position or Telemetry decoded once however many modules ask,
+// re-decoded after a module re-encodes it, never served to another packet; decodes and packet
+// pool copies per received packet before and after, for a typical mix of traffic
+
+#include "DecodedPayloads.h"
+#include <unity.h>
+#include <vector>
+
+// What ProtobufModule<T> does with a packet on its port: handleReceived() decodes the payload
+// for handleReceivedProtobuf(), then alterReceived() decodes it again for alterReceivedProtobuf().
+// shared selects the decodedPayloads path over the stock pb_decode_from_bytes one.
+template <typename T> struct ProtobufConsumer {
+    meshtastic_PortNum port;
+    const pb_msgdesc_t *fields;
+    bool shared;
+    bool alters = false; // Re-encodes the payload, as PositionModule does for our own positions
+
+    bool decode(const meshtastic_MeshPacket &mp, T &scratch)
+    {
+        if (shared) {
+            return decodedPayloads.copyTo(mp, fields, scratch);
+        }
+        memset(&scratch, 0, sizeof(scratch));
+        return pb_decode_from_bytes(mp.decoded.payload.bytes, mp.decoded.payload.size, fields, &scratch);
+    }
+
+    void receive(meshtastic_MeshPacket &mp)
+    {
+        if (mp.decoded.portnum != port) {
+            return;
+        }
+        T scratch;
+        if (!decode(mp, scratch)) { // handleReceived()
+            return;
+        }
+        if (!decode(mp, scratch)) { // alterReceived()
+            return;
+        }
+        if (alters) {
+            meshtastic_Data_payload_t before = mp.decoded.payload;
+            scratch.time += 1;
+            mp.decoded.payload.size =
+                pb_encode_to_bytes(mp.decoded.payload.bytes, sizeof(mp.decoded.payload.bytes), fields, &scratch);
+            if (shared && (mp.decoded.payload.size != before.size ||
+                           memcmp(mp.decoded.payload.bytes, before.bytes, before.size) != 0)) {
+                decodedPayloads.payloadChanged(mp);
+            }
+        }
+    }
+};
+
+// The modules of the gateway build that look inside positions and telemetry, in callModules order
+struct Modules {
+    ProtobufConsumer<meshtastic_Position> position;
+    ProtobufConsumer<meshtastic_Telemetry> device, environment, airQuality, power;
+    bool shared;
+
+    explicit Modules(bool shared)
+        : position{meshtastic_PortNum_POSITION_APP, &meshtastic_Position_msg, shared},
+          device{meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, shared},
+          environment{meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, shared},
+          airQuality{meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, shared},
+          power{meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, shared}, shared(shared)
+    {
+    }
+
+    // TelegramModule::handleReceived: the position for the node table and live locations, the
+    // telemetry for the digests
+    void telegram(const meshtastic_MeshPacket &mp)
+    {
+        if (shared) {
+            decodedPayloads.position(mp);
+            decodedPayloads.telemetry(mp);
+            return;
+        }
+        if (mp.decoded.portnum == meshtastic_PortNum_POSITION_APP) {
+            meshtastic_Position p;
+            pb_decode_from_bytes(mp.decoded.payload.bytes, mp.decoded.payload.size, &meshtastic_Position_msg, &p);
+        } else if (mp.decoded.portnum == meshtastic_PortNum_TELEMETRY_APP) {
+            meshtastic_Telemetry t;
+            pb_decode_from_bytes(mp.decoded.payload.bytes, mp.decoded.payload.size, &meshtastic_Telemetry_msg, &t);
+        }
+    }
+
+    void callModules(meshtastic_MeshPacket &mp)
+    {
+        position.receive(mp);
+        device.receive(mp);
+        environment.receive(mp);
+        airQuality.receive(mp);
+        power.receive(mp);
+        telegram(mp);
+    }
+};
+
+struct Counts {
+    uint32_t packets, decodes, poolCopies;
+};
+
+// Router::handleReceived around callModules: the encrypted copy for MQTT (always before, only when
+// MQTT may publish it after) and the decodedPayloads window
+static Counts receiveAll(Modules &modules, std::vector<meshtastic_MeshPacket> packets, bool mqttEnabled)
+{
+    Counts counts = {};
+    uint32_t decodesBefore = hostPbDecodes;
+    for (meshtastic_MeshPacket &p : packets) {
+        bool fromUs = p.from == 0;
+        if (!modules.shared || (mqttEnabled && !fromUs)) {
+            counts.poolCopies++;
+        }
+        if (modules.shared) {
+            decodedPayloads.beginPacket(p);
+        }
+        modules.callModules(p);
+        if (modules.shared) {
+            decodedPayloads.endPacket();
+        }
+        counts.packets++;
+    }
+    counts.decodes = hostPbDecodes - decodesBefore;
+    return counts;
+}
+
+static meshtastic_MeshPacket positionPacket(NodeNum from, PacketId id)
+{
+    meshtastic_MeshPacket p = {};
+    p.from = from;
+    p.id = id;
+    p.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    p.decoded.portnum = meshtastic_PortNum_POSITION_APP;
+    meshtastic_Position position = meshtastic_Position_init_zero;
+    position.latitude_i = 520000000 + id;
+    position.longitude_i = 45000000;
+    position.time = 1700000000 + id;
+    p.decoded.payload.size =
+        pb_encode_to_bytes(p.decoded.payload.bytes, sizeof(p.decoded.payload.bytes), &meshtastic_Position_msg, &position);
+    return p;
+}
+
+static meshtastic_MeshPacket telemetryPacket(NodeNum from, PacketId id)
+{
+    meshtastic_MeshPacket p = {};
+    p.from = from;
+    p.id = id;
+    p.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    p.decoded.portnum = meshtastic_PortNum_TELEMETRY_APP;
+    meshtastic_Telemetry telemetry = meshtastic_Telemetry_init_zero;
+    telemetry.time = 1700000000 + id;
+    telemetry.which_variant = meshtastic_Telemetry_device_metrics_tag;
+    telemetry.variant.device_metrics.has_voltage = true;
+    telemetry.variant.device_metrics.voltage = 3.9f;
+    p.decoded.payload.size = pb_encode_to_bytes(p.decoded.payload.bytes, sizeof(p.decoded.payload.bytes),
+                                                &meshtastic_Telemetry_msg, &telemetry);
+    return p;
+}
+
+static meshtastic_MeshPacket textPacket(NodeNum from, PacketId id)
+{
+    meshtastic_MeshPacket p = {};
+    p.from = from;
+    p.id = id;
+    p.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    p.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    p.decoded.payload.size = 5;
+    memcpy(p.decoded.payload.bytes, "hello", 5);
+    return p;
+}
+
+void setUp(void)
+{
+    decodedPayloads.endPacket();
+}
+
+void tearDown(void) {}
+
+static void test_one_decode_per_packet(void)
+{
+    meshtastic_MeshPacket p = telemetryPacket(0x1234, 7);
+    decodedPayloads.beginPacket(p);
+    uint32_t before = hostPbDecodes;
+    const meshtastic_Telemetry *first = decodedPayloads.telemetry(p);
+    TEST_ASSERT_NOT_NULL(first);
+    meshtastic_Telemetry copy;
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(decodedPayloads.copyTo(p, &meshtastic_Telemetry_msg, copy));
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, hostPbDecodes - before);
+    TEST_ASSERT_EQUAL_UINT32(1700000007, copy.time);
+    TEST_ASSERT_NULL(decodedPayloads.position(p)); // Wrong port: no decode at all
+    TEST_ASSERT_EQUAL_UINT32(1, hostPbDecodes - before);
+
+    // A module changing its copy doesn't change what the next one gets
+    copy.time = 0;
+    TEST_ASSERT_TRUE(decodedPayloads.copyTo(p, &meshtastic_Telemetry_msg, copy));
+    TEST_ASSERT_EQUAL_UINT32(1700000007, copy.time);
+    decodedPayloads.endPacket();
+}
+
+static void test_never_served_to_another_packet(void)
+{
+    meshtastic_MeshPacket a = positionPacket(0x1234, 1);
+    meshtastic_MeshPacket b = positionPacket(0x1234, 2);
+    decodedPayloads.beginPacket(a);
+    uint32_t before = hostPbDecodes;
+    TEST_ASSERT_EQUAL_INT32(520000001, decodedPayloads.position(a)->latitude_i);
+    TEST_ASSERT_EQUAL_INT32(520000002, decodedPayloads.position(b)->latitude_i);
+    // b isn't the packet being dispatched; its decode took the value, so a's is decoded again
+    TEST_ASSERT_EQUAL_INT32(520000001, decodedPayloads.position(a)->latitude_i);
+    TEST_ASSERT_EQUAL_UINT32(3, hostPbDecodes - before);
+    decodedPayloads.endPacket();
+
+    // Outside Router's window every request decodes
+    before = hostPbDecodes;
+    decodedPayloads.position(a);
+    decodedPayloads.position(a);
+    TEST_ASSERT_EQUAL_UINT32(2, hostPbDecodes - before);
+
+    // A payload that doesn't decode is remembered as such
+    meshtastic_MeshPacket bad = positionPacket(0x1234, 3);
+    bad.decoded.payload.size = 3;
+    decodedPayloads.beginPacket(bad);
+    before = hostPbDecodes;
+    TEST_ASSERT_NULL(decodedPayloads.position(bad));
+    meshtastic_Position scratch;
+    TEST_ASSERT_FALSE(decodedPayloads.copyTo(bad, &meshtastic_Position_msg, scratch));
+    TEST_ASSERT_EQUAL_UINT32(1, hostPbDecodes - before);
+    decodedPayloads.endPacket();
+}
+
+static void test_re_encoded_payload_is_decoded_again(void)
+{
+    Modules modules(true);
+    modules.position.alters = true;
+    meshtastic_MeshPacket p = positionPacket(0, 9); // Our own, which PositionModule re-encodes
+    decodedPayloads.beginPacket(p);
+    uint32_t before = hostPbDecodes;
+    modules.callModules(p);
+    const meshtastic_Position *seen = decodedPayloads.position(p);
+    decodedPayloads.endPacket();
+    TEST_ASSERT_EQUAL_UINT32(1700000009 + 1, seen->time); // Telegram saw the altered payload
+    TEST_ASSERT_EQUAL_UINT32(2, hostPbDecodes - before);
+}
+
+static void test_decodes_and_copies_per_packet(void)
+{
+    // Five minutes of a 60-node mesh: positions every 15 min, device telemetry every 30 min,
+    // plus text and other traffic that no typed consumer decodes
+    std::vector<meshtastic_MeshPacket> packets;
+    PacketId id = 1;
+    for (NodeNum node = 1; node <= 60; node++) {
+        packets.push_back(positionPacket(node, id++));
+        packets.push_back(positionPacket(node, id++));
+        packets.push_back(telemetryPacket(node, id++));
+        packets.push_back(textPacket(node, id++));
+    }
+
+    Modules stock(false), shared(true);
+    Counts before = receiveAll(stock, packets, false);
+    Counts after = receiveAll(shared, packets, false);
+    Counts afterMqtt = receiveAll(shared, packets, true);
+
+    TEST_ASSERT_EQUAL_UINT32(packets.size(), before.poolCopies);
+    TEST_ASSERT_EQUAL_UINT32(0, after.poolCopies);
+    TEST_ASSERT_EQUAL_UINT32(packets.size(), afterMqtt.poolCopies);
+    // One decode per typed packet, however many modules look
+    TEST_ASSERT_EQUAL_UINT32(60 * 3, after.decodes);
+    TEST_ASSERT_EQUAL_UINT32(60 * 2 * 3 + 60 * 9, before.decodes);
+
+    char line[200];
+    snprintf(line, sizeof(line),
+             "per received packet: %.2f decodes and %.2f pool copies before, %.2f decodes and %.2f copies after "
+             "(%.2f with MQTT on)",
+             (double)before.decodes / before.packets, (double)before.poolCopies / before.packets,
+             (double)after.decodes / after.packets, (double)after.poolCopies / after.packets,
+             (double)afterMqtt.poolCopies / afterMqtt.packets);
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_one_decode_per_packet);
+    RUN_TEST(test_never_served_to_another_packet);
+    RUN_TEST(test_re_encoded_payload_is_decoded_again);
+    RUN_TEST(test_decodes_and_copies_per_packet);
+    return UNITY_END();
+}
@@ -0,0 +1,182 @@
+// NodeEvictionQueue: a flood of thousands of new NodeNums into a full NodeDB, with
+// every victim checked against the double scan getOrCreateMeshNode used to do
+
+#include "NodeEvictionQueue.h"
+#include <chrono>
+#include <random>
+#include <unity.h>
+
+static const NodeNum OUR_NUM = 1;
+
+static meshtastic_NodeInfoLite nodes[MAX_NUM_NODES];
+static int count;
+static NodeNumIndex idx;
+static NodeEvictionQueue queue;
+
+void setUp(void)
+{
+    memset(nodes, 0, sizeof(nodes));
+    nodes[0].num = OUR_NUM;
+    count = 1;
+    idx.rebuild(nodes, count);
+    queue.rebuild(nodes, count, OUR_NUM);
+}
+
+void tearDown(void) {}
+
+// The old policy: oldest node without a public key, else the oldest evictable one
+static int scanVictim()
+{
+    uint32_t oldest = UINT32_MAX, oldestBoring = UINT32_MAX;
+    int oldestIndex = -1, oldestBoringIndex = -1;
+    for (int i = 1; i < count; i++) {
+        const meshtastic_NodeInfoLite &node = nodes[i];
+        if (node.is_favorite || node.is_ignored) {
+            continue;
+        }
+        if (!(node.bitfield & NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK) && node.last_heard < oldest) {
+            oldest = node.last_heard;
+            oldestIndex = i;
+        }
+        if (node.user.public_key.size == 0 && node.last_heard < oldestBoring) {
+            oldestBoring = node.last_heard;
+            oldestBoringIndex = i;
+        }
+    }
+    return oldestBoringIndex != -1 ? oldestBoringIndex : oldestIndex;
+}
+
+// getOrCreateMeshNode for a NodeNum we have not seen: evict if full, reuse the slot.
+// victimHeard receives the evicted node's last_heard.
+static meshtastic_NodeInfoLite *create(NodeNum num, uint32_t now, uint32_t &victimHeard)
+{
+    int pos = count;
+    if (count >= MAX_NUM_NODES) {
+        if (queue.isStale()) {
+            queue.rebuild(nodes, count, OUR_NUM);
+        }
+        NodeNum victim = queue.pickVictim(idx, nodes, count);
+        if (!victim) {
+            return nullptr;
+        }
+        pos = idx.find(victim);
+        victimHeard = nodes[pos].last_heard;
+        idx.erase(victim);
+    } else {
+        count++;
+    }
+    meshtastic_NodeInfoLite *node = &nodes[pos];
+    memset(node, 0, sizeof(*node));
+    node->num = num;
+    node->last_heard = now;
+    idx.insert(num, pos);
+    queue.push(*node);
+    return node;
+}
+
+static void test_flood_evicts_what_the_scan_would(void)
+{
+    std::mt19937 rng(1);
+    uint32_t now = 1;
+    NodeNum next = 100;
+    int evictions = 0;
+    for (int step = 0; step < 200000; step++) {
+        int action = rng() % 10;
+        if (action < 4 && count > 1) {
+            nodes[1 + rng() % (count - 1)].last_heard = ++now;
+        } else if (action == 4 && count > 1) {
+            // Flags change all over the firmware; set_favorite is what marks the queue stale
+            meshtastic_NodeInfoLite &node = nodes[1 + rng() % (count - 1)];
+            switch (rng() % 4) {
+            case 0:
+                node.is_favorite = !node.is_favorite;
+                break;
+            case 1:
+                node.is_ignored = !node.is_ignored;
+                break;
+            case 2:
+                node.user.public_key.size ^= 32;
+                break;
+            default:
+                node.bitfield ^= NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK;
+            }
+            queue.markStale();
+        } else {
+            bool full = count >= MAX_NUM_NODES;
+            int expected = full ? scanVictim() : -1;
+            uint32_t expectedHeard = expected >= 0 ? nodes[expected].last_heard : 0;
+            uint32_t victimHeard = 0;
+            meshtastic_NodeInfoLite *node = create(next++, ++now, victimHeard);
+            if (full) {
+                TEST_ASSERT_EQUAL(expected >= 0, node != nullptr);
+                if (node) {
+                    // Ties on last_heard may pick another node, never a different age
+                    TEST_ASSERT_EQUAL_UINT32(expectedHeard, victimHeard);
+                    evictions++;
+                }
+            }
+        }
+        if (step % 97 == 0) {
+            for (int i = 0; i < count; i++) {
+                TEST_ASSERT_EQUAL_INT(i, idx.find(nodes[i].num));
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(OUR_NUM, nodes[0].num);
+    TEST_ASSERT_GREATER_THAN(1000, evictions);
+}
+
+static void test_protected_nodes_are_never_evicted(void)
+{
+    uint32_t victimHeard;
+    for (NodeNum num = 2; count < MAX_NUM_NODES; num++) {
+        meshtastic_NodeInfoLite *node = create(num, num, victimHeard);
+        node->is_favorite = num % 3 == 0;
+        node->is_ignored = num % 3 == 1;
+        node->bitfield = num % 3 == 2 ? NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK : 0;
+        node->user.public_key.size = 32;
+    }
+    queue.rebuild(nodes, count, OUR_NUM);
+    TEST_ASSERT_NULL(create(0xdead, 100000, victimHeard));
+}
+
+// Scan twice and shift the array down, as getOrCreateMeshNode did, against the queue
+static void test_benchmark_flood(void)
+{
+    const int flood = 5000;
+    uint32_t victimHeard;
+    for (NodeNum num = 2; count < MAX_NUM_NODES; num++) {
+        create(num, num, victimHeard);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < flood; i++) {
+        TEST_ASSERT_NOT_NULL(create(0x100000 + i, 1000 + i, victimHeard));
+    }
+    double queueNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < flood; i++) {
+        int victim = scanVictim();
+        memmove(&nodes[victim], &nodes[victim + 1], (count - victim - 1) * sizeof(nodes[0]));
+        meshtastic_NodeInfoLite &node = nodes[count - 1];
+        memset(&node, 0, sizeof(node));
+        node.num = 0x200000 + i;
+        node.last_heard = 10000 + i;
+    }
+    double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    char line[128];
+    snprintf(line, sizeof(line), "%d new nodes into a full %d-node DB: %.0f ns each with the queue, %.0f ns scanning",
+             flood, MAX_NUM_NODES, queueNs / flood, scanNs / flood);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN(scanNs, queueNs);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_flood_evicts_what_the_scan_would);
+    RUN_TEST(test_protected_nodes_are_never_evicted);
+    RUN_TEST(test_benchmark_flood);
+    return UNITY_END();
+}
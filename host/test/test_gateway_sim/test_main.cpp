@@ -0,0 +1,871 @@
+// Gateway simulator: a synthetic mesh and chat driving the gateway's queues, poster and long poller
+// against HostBotServer, reporting mesh->Telegram and Telegram->mesh latency percentiles,
+// throughput and drops.
+//
+// Gateway below mirrors TelegramModule's two sides: the mesh loop (handleReceived, runSteps) and
+// the network task (netStep), joined by the same SPSC rings. The network task's blocking calls go
+// through delay(), and hostDelayHook runs the mesh loop meanwhile, as the other core would. Left
+// out are WiFi, the spool, routes to other chats and heap pressure; they have tests of their own.
+//
+// The nominal load can be changed without editing this file, e.g.
+//   PLATFORMIO_BUILD_FLAGS="-D SIM_PACKETS_PER_MIN=120 -D SIM_TEXT_PERCENT=80" pio test -e native -f test_gateway_sim -v
+
+#include "HostBotServer.h"
+#include "TelegramGeo.h"
+#include "TelegramLiveLocation.h"
+#include "TelegramLongPoller.h"
+#include "TelegramMeshQueue.h"
+#include "TelegramNodeTable.h"
+#include "TelegramOutbox.h"
+#include "TelegramPoster.h"
+#include "TelegramRateLimiter.h"
+#include "TelegramSpscRing.h"
+#include "TelegramTelemetry.h"
+#include "TelegramText.h"
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <unity.h>
+#include <vector>
+
+#ifndef SIM_MINUTES
+#define SIM_MINUTES 10
+#endif
+#ifndef SIM_PACKETS_PER_MIN
+#define SIM_PACKETS_PER_MIN 6    // Mesh packets the gateway hears
+#endif
+#ifndef SIM_TEXT_PERCENT
+#define SIM_TEXT_PERCENT 50      // Of those, text messages
+#endif
+#ifndef SIM_POSITION_PERCENT
+#define SIM_POSITION_PERCENT 30  // and positions; the rest is telemetry
+#endif
+#ifndef SIM_NODES
+#define SIM_NODES 24
+#endif
+#ifndef SIM_CHATS_PER_MIN
+#define SIM_CHATS_PER_MIN 1      // Chat messages bound for the mesh
+#endif
+#ifndef SIM_LONG_PERCENT
+#define SIM_LONG_PERCENT 20      // Of those, ones that take several packets
+#endif
+#ifndef SIM_RTT_MS
+#define SIM_RTT_MS 150
+#endif
+
+// As in TelegramModule.cpp/.h
+#define TELEGRAM_MESSAGE_LIMIT 4096
+#define TELEGRAM_POLL_INTERVAL 1000
+#define TELEGRAM_BATCH_WINDOW_MS 3000
+#define TELEGRAM_LONG_POLL_TICK 50
+#define TELEGRAM_LONG_POLL_RETRY 5000
+#define TELEGRAM_UNREACHABLE_RETRY 10000
+#define TELEGRAM_MESH_TICK 100
+#define TELEGRAM_FORWARD_RING 8
+#define TELEGRAM_REPLY_RING 2
+#define TELEGRAM_COMMAND_RING 4
+#define NODE_STALE_TIMEOUT 3600000
+
+#define SIM_CHAT "-1001234567"
+#define SIM_TX_QUEUE 16  // Router's MAX_TX_QUEUE
+
+struct SimLoad {
+    uint32_t minutes;
+    uint32_t packetsPerMinute;
+    uint8_t textPercent;
+    uint8_t positionPercent;
+    uint16_t nodes;
+    uint32_t chatsPerMinute;
+    uint8_t longPercent;
+    uint32_t chatBurst; // Chat messages sent back to back at the start
+};
+
+struct SimResult {
+    uint32_t packets;
+    uint32_t forwarded;   // Rendered and handed to the network task
+    uint32_t delivered;   // Forwards Telegram accepted, counted at the server
+    uint32_t dropped;     // Forward ring full, outbox overflow, out of retries
+    uint32_t requests;    // sendMessage batches of forwards
+    std::vector<uint32_t> meshToTelegramMs;
+    uint32_t liveSends;   // sendLocation and editMessageLiveLocation accepted
+    uint32_t chats;
+    uint32_t rejected;    // Chat messages turned away: command ring or mesh queue full
+    std::vector<uint32_t> telegramToMeshMs;
+    uint32_t transmitted; // Packets the radio sent
+    uint32_t txHighWater;
+    uint32_t txOverflows;
+    bool inOrder;         // Chat messages reached the air in the order they were sent
+    HostBotStats server;
+};
+
+enum class SimKind : uint8_t { TEXT, POSITION, TELEMETRY, CHAT };
+
+struct SimEvent {
+    uint32_t at; // millis()
+    SimKind kind;
+    uint16_t node;
+    uint32_t seq;
+};
+
+static uint32_t percentile(std::vector<uint32_t> samples, int percent)
+{
+    if (samples.empty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) * percent / 100];
+}
+
+class Gateway
+{
+  public:
+    Gateway(HostBotServer &server, const SimLoad &load)
+        : _sendClient(server), _pollClient(server), _poster(_sendClient, "api.telegram.org"),
+          _poller(_pollClient, "api.telegram.org"), _nodeTable(NODE_STALE_TIMEOUT), _server(server), _load(load),
+          _random(7)
+    {
+        _poster.setToken("123:sim");
+        _poller.setToken("123:sim");
+        _result.inOrder = true;
+        generate();
+    }
+
+    // ---- mesh loop -------------------------------------------------------------------------
+
+    void meshLoop()
+    {
+        uint32_t now = millis();
+        while (_next < _events.size() && (int32_t)(now - _events[_next].at) >= 0) {
+            const SimEvent &event = _events[_next++];
+            if (event.kind == SimKind::CHAT) {
+                chatUserSends(event);
+            } else {
+                handleReceived(event);
+            }
+        }
+        serviceRadio(now);
+        if ((int32_t)(now - _meshWakeAt) >= 0) {
+            _meshWakeAt = now + max(runSteps(), (int32_t)1);
+        }
+    }
+
+    void handleReceived(const SimEvent &event)
+    {
+        _result.packets++;
+        NodeNum num = 0x1000 + event.node;
+        uint32_t arrivedUs = (uint32_t)((uint64_t)event.at * 1000);
+        TrackedNode *tracked = updateNodeSeen(num);
+        char idBuf[12];
+        const char *nodeName = tracked && tracked->name[0] ? tracked->name : idBuf;
+        snprintf(idBuf, sizeof(idBuf), "!%08x", num);
+
+        if (event.kind == SimKind::TEXT) {
+            char message[64];
+            snprintf(message, sizeof(message), "status check %u, all *fine* here", event.seq);
+            TelegramTextBuffer<TELEGRAM_OUTBOX_TEXT_MAX> formatted;
+            formatted.add("📡 *Mesh Message*\n*From:* ").addEscaped(nodeName);
+            formatted.add("\n*Message:* ").addEscaped(message);
+            enqueueForTelegram(formatted, arrivedUs);
+        } else if (event.kind == SimKind::POSITION) {
+            int32_t latitudeI, longitudeI;
+            positionOf(event, latitudeI, longitudeI);
+            if (tracked) {
+                _nodeTable.setLocation(*tracked, latitudeI, longitudeI, 120);
+            }
+            forwardPosition(num, tracked, nodeName, latitudeI, longitudeI, arrivedUs);
+        } else {
+            meshtastic_Telemetry telemetry = {};
+            telemetryOf(event, telemetry);
+            TelegramTextBuffer<TELEGRAM_OUTBOX_TEXT_MAX> changes;
+            if (_telemetry.ingest(num, 0, telemetry, millis(), changes) > 0) {
+                TelegramTextBuffer<TELEGRAM_OUTBOX_TEXT_MAX> formatted;
+                formatted.add("📊 *Telemetry*\n*From:* ").addEscaped(nodeName).add("\n").add(changes.c_str());
+                enqueueForTelegram(formatted, arrivedUs);
+            }
+        }
+    }
+
+    TrackedNode *updateNodeSeen(NodeNum num)
+    {
+        bool isNew = _nodeTable.find(num) == nullptr;
+        TrackedNode *node = _nodeTable.touch(num, millis());
+        if (node && isNew && num % 3 == 0) {
+            // NodeDB knows some long names; underscores need escaping
+            char name[TELEGRAM_NODE_NAME_MAX];
+            snprintf(name, sizeof(name), "Hiker_%u", num & 0xff);
+            _nodeTable.setName(*node, name);
+        }
+        return node;
+    }
+
+    void forwardPosition(NodeNum num, TrackedNode *tracked, const char *nodeName, int32_t latitudeI,
+                         int32_t longitudeI, uint32_t arrivedUs)
+    {
+        uint32_t now = millis();
+        bool report = !tracked || !tracked->hasReported || now - tracked->reportedAt >= TELEGRAM_POSITION_REPORT_MS ||
+                      telegramDistanceM(tracked->reportedLatI, tracked->reportedLonI, latitudeI, longitudeI) >=
+                          TELEGRAM_POSITION_MOVE_M;
+        bool live = report || telegramDistanceM(tracked->liveLatI, tracked->liveLonI, latitudeI, longitudeI) >=
+                                  TELEGRAM_POSITION_JITTER_M;
+        if (report) {
+            if (tracked) {
+                tracked->hasReported = true;
+                tracked->reportedAt = now;
+                tracked->reportedLatI = latitudeI;
+                tracked->reportedLonI = longitudeI;
+            }
+            TelegramTextBuffer<TELEGRAM_OUTBOX_TEXT_MAX> formatted;
+            formatted.add("📍 *Location Shared*\n*From:* ").addEscaped(nodeName);
+            formatted.add("\n*Coordinates:* ").addDegrees(latitudeI).add(", ").addDegrees(longitudeI);
+            formatted.addf("\n*Altitude:* %dm\n", 120);
+            formatted.add("*Map:* https://www.google.com/maps?q=").addDegrees(latitudeI).add(",").addDegrees(longitudeI);
+            enqueueForTelegram(formatted, arrivedUs);
+        }
+        if (live && tracked) {
+            tracked->liveLatI = latitudeI;
+            tracked->liveLonI = longitudeI;
+            ForwardRecord *record = _forwards.claim();
+            if (record) {
+                record->live = true;
+                record->node = num;
+                record->latitudeI = latitudeI;
+                record->longitudeI = longitudeI;
+                _forwards.publish();
+                _netNotified = true;
+            }
+        }
+    }
+
+    void enqueueForTelegram(const TelegramText &formatted, uint32_t arrivedUs)
+    {
+        ForwardRecord *record = _forwards.claim();
+        if (!record) {
+            _result.dropped++;
+            return;
+        }
+        record->live = false;
+        record->arrivedUs = arrivedUs;
+        record->length = min(formatted.length(), sizeof(record->text));
+        memcpy(record->text, formatted.c_str(), record->length);
+        _forwards.publish();
+        _result.forwarded++;
+        _netNotified = true;
+    }
+
+    int32_t runSteps()
+    {
+        handleCommands();
+        return min(serviceMeshQueue(), (int32_t)TELEGRAM_MESH_TICK);
+    }
+
+    void handleCommands()
+    {
+        if (_replies.size() > 0) {
+            return;
+        }
+        CommandRecord *cmd = _commands.front();
+        if (!cmd) {
+            return;
+        }
+
+        size_t ahead = _meshQueue.size();
+        uint8_t fragments = _meshQueue.push(cmd->text, strlen(cmd->text), cmd->chatId, cmd->arrivedAt, cmd->date);
+        uint32_t sentAt = _chatSentAt.front();
+        _chatSentAt.pop_front();
+        if (fragments == 0) {
+            _result.rejected++;
+            sendReply(cmd->chatId, "⚠️ Mesh queue is full, message not sent. Try again shortly.");
+        } else {
+            _meshSentAt.push_back(sentAt);
+            if (fragments > 1 || ahead > 0) {
+                TelegramTextBuffer<96> reply;
+                reply.addf("⏳ Queued for mesh: %u part%s", fragments, fragments > 1 ? "s" : "");
+                sendReply(cmd->chatId, reply.c_str());
+            }
+        }
+        _commands.release();
+    }
+
+    int32_t serviceMeshQueue()
+    {
+        if (_meshQueue.isEmpty()) {
+            return TELEGRAM_POLL_INTERVAL;
+        }
+        uint32_t now = millis();
+        uint32_t wait = _meshQueue.msUntilReady(now, _txQueue.size() - (_onAir ? 1 : 0));
+        if (wait > 0) {
+            return wait;
+        }
+
+        char fragment[TELEGRAM_MESH_FRAGMENT_MAX + 1];
+        size_t length = _meshQueue.peek(fragment, sizeof(fragment));
+        if (_txQueue.size() == SIM_TX_QUEUE) {
+            _result.txOverflows++;
+            return TELEGRAM_POLL_INTERVAL;
+        }
+        MeshMessageInfo done;
+        bool last = _meshQueue.pop(now, done);
+        _txQueue.push_back({_meshQueue.airtimeMs(length), last ? _meshSentAt.front() : 0, last});
+        _result.txHighWater = max(_result.txHighWater, (uint32_t)_txQueue.size());
+        if (last) {
+            _meshSentAt.pop_front();
+            TelegramTextBuffer<64> reply;
+            reply.add("✅ Message sent to mesh");
+            if (done.fragments > 1) {
+                reply.addf(" in %u parts", done.fragments);
+            }
+            sendReply(done.chatId, reply.c_str());
+        }
+        return _meshQueue.isEmpty() ? TELEGRAM_POLL_INTERVAL : _meshQueue.msUntilReady(millis(), 0);
+    }
+
+    void sendReply(const char *chatId, const char *text)
+    {
+        ReplyRecord *reply = _replies.claim();
+        if (!reply) {
+            return;
+        }
+        strncpy(reply->chatId, chatId, sizeof(reply->chatId) - 1);
+        reply->chatId[sizeof(reply->chatId) - 1] = '\0';
+        strncpy(reply->text, text, sizeof(reply->text) - 1);
+        reply->text[sizeof(reply->text) - 1] = '\0';
+        _replies.publish();
+        _netNotified = true;
+    }
+
+    // The radio sends one packet at a time, each for its airtime
+    void serviceRadio(uint32_t now)
+    {
+        if (_onAir && (int32_t)(now - _onAirUntil) >= 0) {
+            TxPacket &sent = _txQueue.front();
+            _result.transmitted++;
+            if (sent.last) {
+                _result.telegramToMeshMs.push_back(now - sent.chatSentAt);
+                if (sent.chatSentAt < _lastOnAir) {
+                    _result.inOrder = false;
+                }
+                _lastOnAir = sent.chatSentAt;
+            }
+            _txQueue.pop_front();
+            _onAir = false;
+        }
+        if (!_onAir && !_txQueue.empty()) {
+            _onAir = true;
+            _onAirUntil = now + _txQueue.front().airtimeMs;
+        }
+    }
+
+    void chatUserSends(const SimEvent &event)
+    {
+        char text[640];
+        int len = snprintf(text, sizeof(text), "msg %u from the chat", event.seq);
+        if (event.node % 100 < _load.longPercent) {
+            // Long enough for three packets
+            while (len < 460) {
+                len += snprintf(text + len, sizeof(text) - len, " and more words");
+            }
+        }
+        _result.chats++;
+        _chatSentAt.push_back(millis());
+        _server.userSends(SIM_CHAT, text);
+    }
+
+    // ---- network task ----------------------------------------------------------------------
+
+    bool netDue(uint32_t now) { return _netNotified || (int32_t)(now - _netWakeAt) >= 0; }
+
+    void netRun()
+    {
+        _netNotified = false;
+        uint32_t wait = netStep();
+        _netWakeAt = millis() + max(wait, (uint32_t)1);
+    }
+
+    uint32_t netStep()
+    {
+        drainForwards();
+        int32_t pollWait = serviceLongPoll();
+        int32_t replyWait = sendReplies();
+        int32_t outboxWait = flushOutbox();
+        int32_t liveWait = serviceLiveLocations();
+        return min(min(min(min(pollWait, replyWait), outboxWait), liveWait), (int32_t)TELEGRAM_POLL_INTERVAL);
+    }
+
+    void drainForwards()
+    {
+        for (ForwardRecord *record = _forwards.front(); record; record = _forwards.front()) {
+            if (record->live) {
+                _live.update(record->node, record->latitudeI, record->longitudeI, millis());
+            } else {
+                _outbox.push(record->text, record->length, record->arrivedUs);
+            }
+            _forwards.release();
+        }
+    }
+
+    int32_t serviceLongPoll()
+    {
+        uint32_t now = millis();
+        if (_poller.state() == TelegramLongPoller::State::FAILED) {
+            if ((int32_t)(now - _pollRetryAt) < 0) {
+                return _pollRetryAt - now;
+            }
+            _poller.reset();
+        }
+        if (_poller.state() == TelegramLongPoller::State::IDLE) {
+            if (!_poller.begin(_updateOffset)) {
+                _pollRetryAt = millis() + TELEGRAM_LONG_POLL_RETRY;
+                return TELEGRAM_LONG_POLL_RETRY;
+            }
+            return TELEGRAM_LONG_POLL_TICK;
+        }
+
+        TelegramLongPoller::State state = _poller.service(now);
+        if (state == TelegramLongPoller::State::FAILED) {
+            _pollRetryAt = now + TELEGRAM_LONG_POLL_RETRY;
+            return TELEGRAM_LONG_POLL_RETRY;
+        }
+        if (state != TelegramLongPoller::State::READY) {
+            return TELEGRAM_LONG_POLL_TICK;
+        }
+        for (uint8_t i = 0; i < _poller.updateCount(); i++) {
+            const TelegramUpdate &update = _poller.update(i);
+            CommandRecord *cmd = _commands.claim();
+            if (!cmd) {
+                // The module answers "Gateway is busy"; the message is lost to the mesh
+                _chatSentAt.pop_front();
+                _result.rejected++;
+                continue;
+            }
+            strncpy(cmd->chatId, update.chatId, sizeof(cmd->chatId) - 1);
+            cmd->chatId[sizeof(cmd->chatId) - 1] = '\0';
+            strncpy(cmd->text, update.text, sizeof(cmd->text) - 1);
+            cmd->text[sizeof(cmd->text) - 1] = '\0';
+            cmd->arrivedAt = _poller.readyAt();
+            cmd->date = update.date;
+            _commands.publish();
+        }
+        _updateOffset = _poller.nextOffset();
+        _poller.reset();
+        return 0;
+    }
+
+    int32_t sendReplies()
+    {
+        uint32_t now = millis();
+        if (_replyRetryAt != 0) {
+            if ((int32_t)(now - _replyRetryAt) < 0) {
+                return _replyRetryAt - now;
+            }
+            _replyRetryAt = 0;
+        }
+        for (ReplyRecord *reply = _replies.front(); reply; reply = _replies.front()) {
+            now = millis();
+            uint32_t wait = _rateLimiter.msUntilReady(now);
+            if (wait > 0 || !_rateLimiter.tryAcquire(now)) {
+                return max(wait, (uint32_t)50);
+            }
+            TelegramPoster::Result result = postMessage(reply->chatId, reply->text, "");
+            if (result == TelegramPoster::Result::REJECTED && _poster.retryAfter() > 0) {
+                _rateLimiter.pauseFor(millis(), _poster.retryAfter());
+                return _poster.retryAfter() * 1000;
+            }
+            if (result == TelegramPoster::Result::UNREACHABLE) {
+                _replyRetryAt = millis() + TELEGRAM_UNREACHABLE_RETRY;
+                return TELEGRAM_UNREACHABLE_RETRY;
+            }
+            _replies.release();
+        }
+        return TELEGRAM_POLL_INTERVAL;
+    }
+
+    int32_t flushOutbox()
+    {
+        uint32_t now = millis();
+        OutboxItem *first = _outbox.peekReady(now);
+        if (!first) {
+            return TELEGRAM_POLL_INTERVAL;
+        }
+
+        size_t count = _singles > 0 ? 1 : _outbox.batchCount(TELEGRAM_MESSAGE_LIMIT);
+        bool batchFull = count < _outbox.size() || _outbox.size() == TELEGRAM_OUTBOX_DEPTH;
+        uint32_t age = now - first->enqueuedAt;
+        if (!batchFull && first->attempts == 0 && _singles == 0 && age < TELEGRAM_BATCH_WINDOW_MS) {
+            return TELEGRAM_BATCH_WINDOW_MS - age;
+        }
+        uint32_t wait = _rateLimiter.msUntilReady(now);
+        if (wait > 0 || !_rateLimiter.tryAcquire(now)) {
+            return max(wait, (uint32_t)50);
+        }
+
+        _batch.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) {
+                _batch.add("\n\n");
+            }
+            const OutboxItem *item = _outbox.peekAt(i);
+            _batch.add(item->text, item->length);
+        }
+
+        _result.requests++;
+        TelegramPoster::Result result = postMessage(SIM_CHAT, _batch.c_str(), "Markdown");
+        if (result == TelegramPoster::Result::OK) {
+            uint32_t sentUs = micros();
+            for (size_t i = 0; i < count; i++) {
+                _result.meshToTelegramMs.push_back((sentUs - _outbox.peekAt(i)->arrivedUs) / 1000);
+            }
+            _outbox.completeFront(count);
+            if (_singles > 0) {
+                _singles--;
+            }
+        } else if (result == TelegramPoster::Result::UNREACHABLE) {
+            _outbox.holdFront(millis() + TELEGRAM_UNREACHABLE_RETRY);
+        } else if (_poster.retryAfter() > 0) {
+            _rateLimiter.pauseFor(millis(), _poster.retryAfter());
+        } else if (count > 1) {
+            _singles = count;
+        } else {
+            bool dropped = _outbox.failFront(millis());
+            if (dropped && _singles > 0) {
+                _singles--;
+            }
+        }
+        return _outbox.isEmpty() ? TELEGRAM_POLL_INTERVAL : 50;
+    }
+
+    int32_t serviceLiveLocations()
+    {
+        LiveLocation *live = _live.nextPending();
+        if (!live) {
+            return TELEGRAM_POLL_INTERVAL;
+        }
+        uint32_t now = millis();
+        uint32_t wait = _rateLimiter.msUntilReady(now);
+        if (wait > 0 || !_rateLimiter.tryAcquire(now)) {
+            return max(wait, (uint32_t)50);
+        }
+
+        TelegramTextBuffer<16> latitude;
+        TelegramTextBuffer<16> longitude;
+        latitude.addDegrees(live->latitudeI);
+        longitude.addDegrees(live->longitudeI);
+        StaticJsonDocument<JSON_OBJECT_SIZE(4)> payload;
+        payload["chat_id"] = SIM_CHAT;
+        payload["latitude"] = serialized(latitude.c_str());
+        payload["longitude"] = serialized(longitude.c_str());
+        bool edit = _live.isLive(*live, now);
+        if (edit) {
+            payload["message_id"] = live->messageId;
+        } else {
+            payload["live_period"] = TELEGRAM_LIVE_PERIOD_S;
+        }
+
+        TelegramPoster::Result result =
+            _poster.post(edit ? "editMessageLiveLocation" : "sendLocation", payload.as<JsonObject>());
+        if (result == TelegramPoster::Result::OK) {
+            _result.liveSends++;
+            if (edit) {
+                _live.edited(*live);
+            } else {
+                _live.started(*live, _poster.messageId(), millis());
+            }
+        } else if (result == TelegramPoster::Result::REJECTED && _poster.retryAfter() > 0) {
+            _rateLimiter.pauseFor(millis(), _poster.retryAfter());
+        } else if (result == TelegramPoster::Result::REJECTED) {
+            _live.failed(*live);
+        }
+        return 50;
+    }
+
+    TelegramPoster::Result postMessage(const char *chatId, const char *text, const char *parseMode)
+    {
+        StaticJsonDocument<JSON_OBJECT_SIZE(4)> payload;
+        payload["chat_id"] = chatId;
+        payload["text"] = text;
+        if (parseMode[0]) {
+            payload["parse_mode"] = parseMode;
+        }
+        return _poster.post("sendMessage", payload.as<JsonObject>());
+    }
+
+    // ---- simulation ------------------------------------------------------------------------
+
+    bool idle()
+    {
+        return _next == _events.size() && !_forwards.front() && _outbox.isEmpty() && !_replies.front() &&
+               !_commands.front() && _meshQueue.isEmpty() && _txQueue.empty() && !_live.nextPending() &&
+               _server.unconfirmed() == 0 && _chatSentAt.empty();
+    }
+
+    SimResult &finish()
+    {
+        _result.dropped += _outbox.stats().droppedOverflow + _outbox.stats().droppedRetries;
+        for (const HostBotRequest &request : _server.accepted()) {
+            if (request.method != "sendMessage") {
+                continue;
+            }
+            for (size_t at = request.body.find("*From:*"); at != std::string::npos;
+                 at = request.body.find("*From:*", at + 1)) {
+                _result.delivered++;
+            }
+        }
+        _result.server = _server.stats();
+        return _result;
+    }
+
+  private:
+    struct ForwardRecord {
+        bool live;
+        uint32_t arrivedUs;
+        uint16_t length;
+        char text[TELEGRAM_OUTBOX_TEXT_MAX];
+        NodeNum node;
+        int32_t latitudeI;
+        int32_t longitudeI;
+    };
+
+    struct ReplyRecord {
+        char chatId[TELEGRAM_UPDATE_CHAT_MAX];
+        char text[TELEGRAM_MESSAGE_LIMIT + 1];
+    };
+
+    struct CommandRecord {
+        char chatId[TELEGRAM_UPDATE_CHAT_MAX];
+        uint32_t arrivedAt;
+        uint32_t date;
+        char text[TELEGRAM_UPDATE_TEXT_MAX + 1];
+    };
+
+    struct TxPacket {
+        uint32_t airtimeMs;
+        uint32_t chatSentAt; // For the last fragment of a chat message
+        bool last;
+    };
+
+    void generate()
+    {
+        // Poisson arrivals for the mesh and the chat, merged in time order
+        std::exponential_distribution<double> packetGap(_load.packetsPerMinute / 60000.0);
+        std::exponential_distribution<double> chatGap(_load.chatsPerMinute / 60000.0);
+        std::uniform_int_distribution<int> percent(0, 99);
+        std::uniform_int_distribution<int> node(0, _load.nodes - 1);
+        uint32_t start = millis() + 1;
+        uint32_t end = start + _load.minutes * 60000;
+        uint32_t seq = 0;
+
+        for (double t = start + packetGap(_random); _load.packetsPerMinute && t < end; t += packetGap(_random)) {
+            int p = percent(_random);
+            SimKind kind = p < _load.textPercent                             ? SimKind::TEXT
+                           : p < _load.textPercent + _load.positionPercent ? SimKind::POSITION
+                                                                             : SimKind::TELEMETRY;
+            _events.push_back({(uint32_t)t, kind, (uint16_t)node(_random), seq++});
+        }
+        for (uint32_t i = 0; i < _load.chatBurst; i++) {
+            _events.push_back({start + i * 300, SimKind::CHAT, (uint16_t)percent(_random), seq++});
+        }
+        for (double t = start + chatGap(_random); _load.chatsPerMinute && t < end; t += chatGap(_random)) {
+            _events.push_back({(uint32_t)t, SimKind::CHAT, (uint16_t)percent(_random), seq++});
+        }
+        std::stable_sort(_events.begin(), _events.end(),
+                         [](const SimEvent &a, const SimEvent &b) { return a.at < b.at; });
+    }
+
+    // A third of the nodes walk 150 m per report, the rest sit still with GPS jitter
+    void positionOf(const SimEvent &event, int32_t &latitudeI, int32_t &longitudeI)
+    {
+        std::uniform_int_distribution<int32_t> jitter(-120, 120);
+        int32_t steps = event.node % 3 == 0 ? event.seq : 0;
+        latitudeI = 477000000 + event.node * 150000 + steps * 1350 + jitter(_random);
+        longitudeI = 85000000 + event.node * 150000 + jitter(_random);
+    }
+
+    // Batteries drain a little per report; some nodes also carry an environment sensor
+    void telemetryOf(const SimEvent &event, meshtastic_Telemetry &t)
+    {
+        if (event.node % 4 == 1 && event.seq % 2) {
+            t.which_variant = meshtastic_Telemetry_environment_metrics_tag;
+            t.variant.environment_metrics.has_temperature = true;
+            t.variant.environment_metrics.temperature = 18 + (event.seq % 40) / 10.0f;
+            t.variant.environment_metrics.has_relative_humidity = true;
+            t.variant.environment_metrics.relative_humidity = 55;
+            return;
+        }
+        t.which_variant = meshtastic_Telemetry_device_metrics_tag;
+        t.variant.device_metrics.has_battery_level = true;
+        t.variant.device_metrics.battery_level = 100 - (event.seq / 8) % 60;
+        t.variant.device_metrics.has_voltage = true;
+        t.variant.device_metrics.voltage = 3.6f + t.variant.device_metrics.battery_level / 180.0f;
+        t.variant.device_metrics.has_channel_utilization = true;
+        t.variant.device_metrics.channel_utilization = 8.5f;
+    }
+
+    HostBotServer::Connection _sendClient;
+    HostBotServer::Connection _pollClient;
+    TelegramPoster _poster;
+    TelegramLongPoller _poller;
+    TelegramRateLimiter _rateLimiter;
+    TelegramOutbox _outbox;
+    TelegramTextBuffer<TELEGRAM_MESSAGE_LIMIT + 1> _batch;
+    size_t _singles = 0;
+    TelegramLiveLocations _live;
+    TelegramMeshQueue _meshQueue;
+    TelegramNodeTable _nodeTable;
+    TelegramTelemetry _telemetry;
+    TelegramSpscRing<ForwardRecord, TELEGRAM_FORWARD_RING> _forwards;
+    TelegramSpscRing<ReplyRecord, TELEGRAM_REPLY_RING> _replies;
+    TelegramSpscRing<CommandRecord, TELEGRAM_COMMAND_RING> _commands;
+    int32_t _updateOffset = 0;
+    uint32_t _pollRetryAt = 0;
+    uint32_t _replyRetryAt = 0;
+    uint32_t _netWakeAt = 0;
+    uint32_t _meshWakeAt = 0;
+    bool _netNotified = false;
+
+    std::deque<TxPacket> _txQueue;
+    bool _onAir = false;
+    uint32_t _onAirUntil = 0;
+    uint32_t _lastOnAir = 0;
+
+    HostBotServer &_server;
+    SimLoad _load;
+    std::mt19937 _random;
+    std::vector<SimEvent> _events;
+    size_t _next = 0;
+    std::deque<uint32_t> _chatSentAt; // Chat messages not yet in the mesh queue, by send time
+    std::deque<uint32_t> _meshSentAt; // The same for messages in the mesh queue
+    SimResult _result = {};
+};
+
+static Gateway *running;
+
+static SimResult simulate(const SimLoad &load, const HostBotConfig &bot = HostBotConfig())
+{
+    hostSetMillis(1000);
+    HostBotServer server(bot);
+    Gateway *gateway = new Gateway(server, load);
+    running = gateway;
+    hostDelayHook = [] { running->meshLoop(); };
+
+    // After the load ends, give the queues up to five minutes to drain
+    uint32_t end = millis() + (load.minutes + 5) * 60000;
+    while ((int32_t)(millis() - end) < 0 && !(millis() > 1000 + load.minutes * 60000 && gateway->idle())) {
+        gateway->meshLoop();
+        if (gateway->netDue(millis())) {
+            gateway->netRun();
+        }
+        delay(1);
+    }
+
+    hostDelayHook = nullptr;
+    SimResult result = gateway->finish();
+    delete gateway;
+    return result;
+}
+
+static void report(const char *name, const SimLoad &load, const SimResult &r)
+{
+    char line[320];
+    snprintf(line, sizeof(line),
+             "%s, mesh->Telegram: %u packets, %u forwarded, %u delivered in %u requests (%.1f/min), %u dropped, "
+             "%u live location sends; latency p50 %u ms, p90 %u ms, p99 %u ms, max %u ms",
+             name, r.packets, r.forwarded, r.delivered, r.requests, r.delivered / (double)load.minutes, r.dropped,
+             r.liveSends, percentile(r.meshToTelegramMs, 50), percentile(r.meshToTelegramMs, 90),
+             percentile(r.meshToTelegramMs, 99), percentile(r.meshToTelegramMs, 100));
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line),
+             "%s, Telegram->mesh: %u messages, %u rejected, %u packets sent; latency p50 %u ms, p90 %u ms, "
+             "p99 %u ms, max %u ms; TX queue high water %u, %u overflows",
+             name, r.chats, r.rejected, r.transmitted, percentile(r.telegramToMeshMs, 50),
+             percentile(r.telegramToMeshMs, 90), percentile(r.telegramToMeshMs, 99),
+             percentile(r.telegramToMeshMs, 100), r.txHighWater, r.txOverflows);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "%s, server: %u connects, %u sends accepted, %u answered 429, %u connections dropped",
+             name, r.server.connects, r.server.accepted, r.server.limited, r.server.dropped);
+    TEST_MESSAGE(line);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_nominal_load(void)
+{
+    SimLoad load = {SIM_MINUTES,      SIM_PACKETS_PER_MIN, SIM_TEXT_PERCENT, SIM_POSITION_PERCENT,
+                    SIM_NODES,        SIM_CHATS_PER_MIN,   SIM_LONG_PERCENT, 0};
+    HostBotConfig bot;
+    bot.rttMs = SIM_RTT_MS;
+    SimResult r = simulate(load, bot);
+    report("nominal", load, r);
+
+    TEST_ASSERT_EQUAL_UINT32(0, r.dropped);
+    TEST_ASSERT_EQUAL_UINT32(r.forwarded, r.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, r.rejected);
+    TEST_ASSERT_EQUAL_size_t(r.chats, r.telegramToMeshMs.size());
+    TEST_ASSERT_TRUE(r.inOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, r.txOverflows);
+}
+
+static void test_busy_mesh_is_batched(void)
+{
+    // One packet a second is three times Telegram's limit for a chat, were each sent on its own
+    SimLoad load = {10, 60, 60, 20, 40, 1, 20, 0};
+    SimResult r = simulate(load);
+    report("busy", load, r);
+
+    TEST_ASSERT_EQUAL_UINT32(0, r.dropped);
+    TEST_ASSERT_EQUAL_UINT32(r.forwarded, r.delivered);
+    TEST_ASSERT_LESS_THAN_UINT32(r.delivered, r.requests);
+    TEST_ASSERT_EQUAL_size_t(r.chats - r.rejected, r.telegramToMeshMs.size());
+}
+
+static void test_overload_accounts_for_every_packet(void)
+{
+    // Ten packets a second of long texts outruns what one chat can take; the outbox sheds the oldest
+    SimLoad load = {3, 600, 100, 0, 60, 0, 0, 0};
+    SimResult r = simulate(load);
+    report("overload", load, r);
+
+    TEST_ASSERT_GREATER_THAN_UINT32(0, r.dropped);
+    TEST_ASSERT_EQUAL_UINT32(r.packets, r.delivered + r.dropped);
+}
+
+static void test_flaky_link_loses_nothing(void)
+{
+    SimLoad load = {10, 20, 50, 30, SIM_NODES, 2, 20, 0};
+    HostBotConfig bot;
+    bot.dropPercent = 10;
+    bot.rttMs = 600;
+    SimResult r = simulate(load, bot);
+    report("flaky", load, r);
+
+    TEST_ASSERT_GREATER_THAN_UINT32(0, r.server.dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, r.dropped);
+    TEST_ASSERT_EQUAL_UINT32(r.forwarded, r.delivered);
+    TEST_ASSERT_EQUAL_size_t(r.chats - r.rejected, r.telegramToMeshMs.size());
+    TEST_ASSERT_TRUE(r.inOrder);
+}
+
+static void test_chat_burst_reaches_the_mesh_in_order(void)
+{
+    // Twenty messages in six seconds, a fifth of them three packets long
+    SimLoad load = {1, 6, 50, 30, SIM_NODES, 0, 20, 20};
+    SimResult r = simulate(load);
+    report("chat burst", load, r);
+
+    TEST_ASSERT_EQUAL_UINT32(20, r.chats);
+    TEST_ASSERT_EQUAL_size_t(r.chats - r.rejected, r.telegramToMeshMs.size());
+    TEST_ASSERT_TRUE(r.inOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, r.txOverflows);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(TELEGRAM_MESH_TX_WATERMARK + 1, r.txHighWater);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_nominal_load);
+    RUN_TEST(test_busy_mesh_is_batched);
+    RUN_TEST(test_overload_accounts_for_every_packet);
+    RUN_TEST(test_flaky_link_loses_nothing);
+    RUN_TEST(test_chat_burst_reaches_the_mesh_in_order);
+    return UNITY_END();
+}
@@ -0,0 +1,312 @@
+// TelegramHistory: samples read back as recorded across clock steps, extreme values and the
+// sighting gap; a failed block write, a reset and a damaged block; a full block waiting for the
+// network task; a month of synthetic sightings and telemetry from 10 nodes checked against what
+// was recorded, with bytes per sample, append cost, block writes and query latency
+//
+// Metric ids are those of TelegramModule: TelemetryMetric, then HISTORY_SEEN for sightings.
+
+#include "FSCommon.h"
+#include "TelegramHistory.h"
+#include "TelegramTelemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <tuple>
+#include <unity.h>
+#include <vector>
+
+#define HISTORY_SEEN ((uint8_t)TelemetryMetric::COUNT) // As in TelegramModule.h
+#define HISTORY_SEEN_GAP_S 600
+#define T0 1760000000 // Unix seconds the synthetic month starts at
+#define DAYS 30
+
+struct Sample {
+    NodeNum node;
+    uint8_t metric;
+    uint32_t time;
+    int16_t value;
+
+    bool operator<(const Sample &o) const
+    {
+        return std::tie(node, metric, time, value) < std::tie(o.node, o.metric, o.time, o.value);
+    }
+    bool operator==(const Sample &o) const
+    {
+        return node == o.node && metric == o.metric && time == o.time && value == o.value;
+    }
+};
+
+struct Found {
+    NodeNum node;
+    std::vector<Sample> samples;
+};
+
+static void collect(void *context, uint8_t metric, uint32_t time, int16_t value)
+{
+    Found *found = (Found *)context;
+    found->samples.push_back({found->node, metric, time, value});
+}
+
+static std::vector<Sample> query(TelegramHistory &history, NodeNum node, uint32_t metrics, uint32_t from, uint32_t to)
+{
+    Found found = {node, {}};
+    TEST_ASSERT_EQUAL_UINT32(history.query(node, metrics, from, to, collect, &found), found.samples.size());
+    return found.samples;
+}
+
+void setUp(void)
+{
+    hostFiles.clear();
+    hostWriteBudget = -1;
+    hostSetMillis(0);
+}
+
+void tearDown(void) {}
+
+static void test_samples_read_back_as_recorded(void)
+{
+    TelegramHistory history;
+    TEST_ASSERT_TRUE(history.begin());
+    // The clock steps back twice; the extremes of int16_t survive the deltas
+    TEST_ASSERT_TRUE(history.record(1, 0, 1000, 50));
+    TEST_ASSERT_TRUE(history.record(1, 0, 1100, 49));
+    TEST_ASSERT_TRUE(history.record(1, 0, 900, 48));
+    TEST_ASSERT_TRUE(history.record(1, 0, 1000, -32768));
+    TEST_ASSERT_TRUE(history.record(1, 0, 5000, 32767));
+    TEST_ASSERT_TRUE(history.record(2, 0, 1000, 7));
+    std::vector<Sample> got = query(history, 1, 1, 0, 10000);
+    std::vector<Sample> want = {{1, 0, 1000, 50}, {1, 0, 1100, 49}, {1, 0, 900, 48}, {1, 0, 1000, -32768},
+                                {1, 0, 5000, 32767}};
+    TEST_ASSERT_TRUE(got == want);
+    TEST_ASSERT_EQUAL_UINT32(0, query(history, 1, 2, 0, 10000).size());
+    TEST_ASSERT_EQUAL_UINT32(2, query(history, 1, 1, 1000, 1100).size());
+
+    // A sighting within the gap of the last one is left out
+    TEST_ASSERT_TRUE(history.record(1, HISTORY_SEEN, 5000, 60, HISTORY_SEEN_GAP_S));
+    TEST_ASSERT_FALSE(history.record(1, HISTORY_SEEN, 5000 + HISTORY_SEEN_GAP_S - 1, 61, HISTORY_SEEN_GAP_S));
+    TEST_ASSERT_TRUE(history.record(1, HISTORY_SEEN, 5000 + HISTORY_SEEN_GAP_S, 62, HISTORY_SEEN_GAP_S));
+    TEST_ASSERT_EQUAL_UINT32(2, query(history, 1, 1u << HISTORY_SEEN, 0, 10000).size());
+    TEST_ASSERT_EQUAL_UINT32(8, history.stats().samples);
+}
+
+static void test_failed_write_reset_and_damaged_block(void)
+{
+    TelegramHistory *history = new TelegramHistory();
+    history->begin();
+    for (uint32_t i = 0; i < 6; i++) {
+        history->record(1, 0, 1000 + i * 60, 50 - i);
+    }
+    // Nothing is written before the flush interval, and a failed write is counted, not lost
+    history->service(TELEGRAM_HISTORY_FLUSH_MS - 1);
+    TEST_ASSERT_EQUAL_UINT32(0, history->stats().blockWrites);
+    hostWriteBudget = 0;
+    history->service(TELEGRAM_HISTORY_FLUSH_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, history->stats().writeErrors);
+    hostWriteBudget = -1;
+    history->service(2 * TELEGRAM_HISTORY_FLUSH_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, history->stats().blockWrites);
+
+    // After a reset the unfinished block carries on where it was written
+    delete history;
+    history = new TelegramHistory();
+    TEST_ASSERT_TRUE(history->begin());
+    TEST_ASSERT_EQUAL_UINT32(6, query(*history, 1, 1, 0, 10000).size());
+    history->record(1, 0, 2000, 40);
+    TEST_ASSERT_EQUAL_UINT32(7, query(*history, 1, 1, 0, 10000).size());
+    TEST_ASSERT_EQUAL_UINT32(1000, history->oldest());
+
+    // A damaged block is given up at startup
+    hostFiles.begin()->second[40] ^= 0xFF;
+    delete history;
+    history = new TelegramHistory();
+    TEST_ASSERT_TRUE(history->begin());
+    TEST_ASSERT_EQUAL_UINT32(1, history->stats().corrupt);
+    TEST_ASSERT_EQUAL_UINT32(0, query(*history, 1, 1, 0, 10000).size());
+    TEST_ASSERT_EQUAL_UINT32(0, history->oldest());
+    delete history;
+}
+
+static void test_full_block_waits_for_the_network_task(void)
+{
+    TelegramHistory history;
+    history.begin();
+    uint32_t opens = hostFileOpens;
+    uint32_t time = 100000, recorded = 0;
+    while (!history.writePending()) {
+        history.record(7, 1, time, (int16_t)(recorded * 37));
+        time += 60 + recorded % 5;
+        recorded++;
+    }
+    // Handed over but not written: record() never touches flash, the query still sees it all
+    TEST_ASSERT_EQUAL_UINT32(0, history.stats().blockWrites);
+    TEST_ASSERT_EQUAL_UINT32(opens, hostFileOpens);
+    TEST_ASSERT_EQUAL_UINT32(recorded, query(history, 7, 2, 0, UINT32_MAX).size());
+
+    // The next block fills too before the network task gets to it: samples are dropped
+    uint32_t more = 0;
+    while (history.stats().dropped == 0) {
+        history.record(7, 1, time, (int16_t)more);
+        time += 60;
+        more++;
+    }
+    history.service(0);
+    TEST_ASSERT_FALSE(history.writePending());
+    TEST_ASSERT_EQUAL_UINT32(1, history.stats().blockWrites);
+    TEST_ASSERT_EQUAL_UINT32(recorded + more - 1, query(history, 7, 2, 0, UINT32_MAX).size());
+}
+
+// Ten nodes for a month: sightings every 1-5 minutes, device metrics every 30 minutes, and
+// three nodes with environment sensors every 15 minutes
+struct Event {
+    uint32_t time;
+    NodeNum node;
+    uint8_t metric;
+    int16_t value;
+    uint32_t minGapS;
+};
+
+static NodeNum monthNode(int n)
+{
+    return 0xa1b20000 + n * 7919;
+}
+
+static std::vector<Event> month()
+{
+    std::mt19937 rng(7);
+    std::vector<Event> events;
+    for (int n = 0; n < 10; n++) {
+        NodeNum node = monthNode(n);
+        int snr = 50;
+        for (uint32_t t = T0 + rng() % 180; t < T0 + DAYS * 86400; t += 60 + rng() % 240) {
+            snr = std::max(-150, std::min(120, snr + (int)(rng() % 21) - 10));
+            events.push_back({t, node, HISTORY_SEEN, (int16_t)snr, HISTORY_SEEN_GAP_S});
+        }
+        double battery = 90;
+        for (uint32_t t = T0 + rng() % 1800; t < T0 + DAYS * 86400; t += 1800 + rng() % 11 - 5) {
+            // Solar: charging by day, draining by night
+            battery += ((t / 3600) % 24 < 12 ? 0.8 : -0.9) + ((int)(rng() % 3) - 1) * 0.3;
+            battery = std::max(5.0, std::min(100.0, battery));
+            events.push_back({t, node, (uint8_t)TelemetryMetric::BATTERY, (int16_t)battery, 0});
+            events.push_back({t, node, (uint8_t)TelemetryMetric::VOLTAGE, (int16_t)(330 + battery * 0.9), 0});
+            events.push_back({t, node, (uint8_t)TelemetryMetric::CHANNEL_UTIL, (int16_t)(80 + rng() % 60), 0});
+            events.push_back({t, node, (uint8_t)TelemetryMetric::AIR_UTIL_TX, (int16_t)(5 + rng() % 15), 0});
+        }
+        if (n < 3) {
+            int temperature = 150, humidity = 600, pressure = 10130;
+            for (uint32_t t = T0 + rng() % 900; t < T0 + DAYS * 86400; t += 900 + rng() % 5 - 2) {
+                temperature += (int)(rng() % 7) - 3;
+                humidity += (int)(rng() % 11) - 5;
+                pressure += (int)(rng() % 5) - 2;
+                events.push_back({t, node, (uint8_t)TelemetryMetric::TEMPERATURE, (int16_t)temperature, 0});
+                events.push_back({t, node, (uint8_t)TelemetryMetric::HUMIDITY, (int16_t)humidity, 0});
+                events.push_back({t, node, (uint8_t)TelemetryMetric::PRESSURE, (int16_t)pressure, 0});
+            }
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.time < b.time; });
+    return events;
+}
+
+static void test_month_of_samples(void)
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<Event> events = month();
+    std::vector<Sample> recorded;
+    TelegramHistory *history = new TelegramHistory();
+    history->begin();
+    double appendNs = 0;
+    bool reset = false;
+    uint32_t opensBefore = hostFileOpens;
+    for (const Event &e : events) {
+        hostSetMillis((e.time - T0) * 1000);
+        history->service(millis());
+        auto start = Clock::now();
+        bool ok = history->record(e.node, e.metric, e.time, e.value, e.minGapS);
+        appendNs += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (ok) {
+            recorded.push_back({e.node, e.metric, e.time, e.value});
+        }
+        if (!reset && e.time > T0 + 10 * 86400) {
+            // A reset on day 10, right after a flush, loses nothing
+            history->service(millis() + TELEGRAM_HISTORY_FLUSH_MS);
+            delete history;
+            history = new TelegramHistory();
+            TEST_ASSERT_TRUE(history->begin());
+            reset = true;
+        }
+    }
+    history->service(millis() + TELEGRAM_HISTORY_FLUSH_MS);
+    uint32_t writes = hostFileOpens - opensBefore;
+    TEST_ASSERT_EQUAL_UINT32(0, history->stats().dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, history->stats().writeErrors);
+    TEST_ASSERT_TRUE(history->stats().evicted > 0);
+    TEST_ASSERT_EQUAL_UINT32(TELEGRAM_HISTORY_BLOCKS, history->blocks());
+    TEST_ASSERT_EQUAL_UINT32(TELEGRAM_HISTORY_BLOCKS, hostFiles.size());
+    for (const auto &file : hostFiles) {
+        TEST_ASSERT_TRUE(file.second.size() <= TELEGRAM_HISTORY_BLOCK_BYTES);
+    }
+
+    // Everything after the oldest sample held reads back; blocks start and end on whole seconds
+    // shared with their neighbours, so the oldest second itself may be partly evicted
+    const uint32_t end = T0 + DAYS * 86400;
+    const uint32_t oldest = history->oldest();
+    TEST_ASSERT_TRUE(oldest > T0);
+    uint32_t held = 0;
+    for (const Sample &s : recorded) {
+        held += s.time > oldest;
+    }
+    for (int n = 0; n < 10; n++) {
+        for (uint32_t range : {86400u, 7 * 86400u, 30 * 86400u}) {
+            uint32_t from = std::max(end - range, oldest + 1);
+            for (uint32_t metrics : {1u, 1u << HISTORY_SEEN, (1u << (HISTORY_SEEN + 1)) - 1}) {
+                std::vector<Sample> want, got = query(*history, monthNode(n), metrics, from, end);
+                for (const Sample &s : recorded) {
+                    if (s.node == monthNode(n) && (metrics & (1u << s.metric)) && s.time >= from && s.time < end) {
+                        want.push_back(s);
+                    }
+                }
+                std::sort(want.begin(), want.end());
+                std::sort(got.begin(), got.end());
+                TEST_ASSERT_EQUAL_UINT32(want.size(), got.size());
+                TEST_ASSERT_TRUE(want == got);
+            }
+        }
+    }
+
+    double bytesPerSample = (double)history->bytesUsed() / held;
+    TEST_ASSERT_TRUE(bytesPerSample < 3);
+    char line[200];
+    snprintf(line, sizeof(line),
+             "%u events, %u recorded; %u samples over the last %.1f days held in %u bytes: %.2f bytes/sample "
+             "(11 raw); append %.0f ns; %u block writes (%.1f/day)",
+             (unsigned)events.size(), (unsigned)recorded.size(), held, (end - oldest) / 86400.0,
+             history->bytesUsed(), bytesPerSample, appendNs / events.size(), writes, (double)writes / DAYS);
+    TEST_MESSAGE(line);
+
+    for (uint32_t range : {86400u, 7 * 86400u, 30 * 86400u}) {
+        for (uint32_t metrics : {1u << (uint8_t)TelemetryMetric::BATTERY, (1u << (HISTORY_SEEN + 1)) - 1}) {
+            const int queries = 200;
+            uint32_t found = 0;
+            auto start = Clock::now();
+            for (int q = 0; q < queries; q++) {
+                found = query(*history, monthNode(0), metrics, end - range, end).size();
+            }
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queries;
+            snprintf(line, sizeof(line), "/history %2u d %s: %4u samples in %6.1f us, %5u of %u bytes read", range / 86400,
+                     metrics == 1 ? "battery" : "all    ", found, us, history->stats().lastQueryRead,
+                     history->bytesUsed());
+            TEST_MESSAGE(line);
+        }
+    }
+    delete history;
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_samples_read_back_as_recorded);
+    RUN_TEST(test_failed_write_reset_and_damaged_block);
+    RUN_TEST(test_full_block_waits_for_the_network_task);
+    RUN_TEST(test_month_of_samples);
+    return UNITY_END();
+}
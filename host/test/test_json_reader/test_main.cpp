@@ -0,0 +1,314 @@
+// TelegramJsonReader: random documents fed in random chunk sizes against the
+// values and paths they were generated from, malformed input, and throughput on
+// a getUpdates body
+
+#include "TelegramJsonReader.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+struct Expected {
+    std::string path;
+    JsonToken type;
+    std::string value;
+    bool truncated;
+    int depth; // Containers around the value
+};
+
+// Checks every reported value against the next expected one, path included
+class CheckingHandler : public TelegramJsonHandler
+{
+  public:
+    std::vector<Expected> expected;
+    size_t seen = 0;
+    bool ok = true;
+
+    void onValue(const TelegramJsonReader &reader, JsonToken type, const char *value, size_t len,
+                 bool truncated) override
+    {
+        if (seen >= expected.size()) {
+            ok = false;
+            return;
+        }
+        const Expected &e = expected[seen++];
+        // Values below TELEGRAM_JSON_MAX_DEPTH are reported but match no path
+        bool matchable = e.depth <= TELEGRAM_JSON_MAX_DEPTH;
+        if (e.type != type || e.value != std::string(value, len) || e.truncated != truncated ||
+            reader.pathIs(e.path.c_str()) != matchable) {
+            ok = false;
+
+        }
+    }
+};
+
+static void appendUtf8(std::string &out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+// Random JSON, with the values and paths the reader should report for it
+class Generator
+{
+  public:
+    explicit Generator(uint32_t seed) : _rng(seed) {}
+
+    std::string document(std::vector<Expected> &expected)
+    {
+        _expected = &expected;
+        std::string json;
+        value(json, "", 0);
+        return json;
+    }
+
+  private:
+    uint32_t pick(uint32_t n) { return _rng() % n; }
+
+    void value(std::string &json, const std::string &path, int depth)
+    {
+        // Containers at the top, scalars only a little past the tracked depth
+        uint32_t kind = depth == 0 ? pick(2) : depth < TELEGRAM_JSON_MAX_DEPTH + 2 ? pick(8) : 2 + pick(3);
+        if (kind == 0 || kind == 5) {
+            object(json, path, depth);
+        } else if (kind == 1 || kind == 6) {
+            array(json, path, depth);
+        } else if (kind == 2 || kind == 7) {
+            string(json, path, depth);
+        } else if (kind == 3) {
+            static const char *numbers[] = {"0", "-1", "42", "3.25", "-0.5e-3", "1E+9", "123456789012"};
+            const char *n = numbers[pick(7)];
+            json += n;
+            _expected->push_back({path, JsonToken::NUMBER, n, false, depth});
+        } else {
+            static const char *literals[] = {"true", "false", "null"};
+            uint32_t l = pick(3);
+            json += literals[l];
+            _expected->push_back({path, l < 2 ? JsonToken::BOOL : JsonToken::NULL_VALUE, literals[l], false, depth});
+        }
+    }
+
+    void object(std::string &json, const std::string &path, int depth)
+    {
+        json += pick(2) ? "{" : "{ ";
+        uint32_t members = pick(5);
+        for (uint32_t i = 0; i < members; i++) {
+            if (i > 0) {
+                json += pick(2) ? "," : " ,\n";
+            }
+            std::string key;
+            for (uint32_t k = 1 + pick(10); k > 0; k--) {
+                key += (char)('a' + pick(26));
+            }
+            json += "\"" + key + "\"" + (pick(2) ? ":" : " : ");
+            value(json, path.empty() ? key : path + "." + key, depth + 1);
+        }
+        json += "}";
+    }
+
+    void array(std::string &json, const std::string &path, int depth)
+    {
+        json += "[";
+        uint32_t elements = pick(5);
+        for (uint32_t i = 0; i < elements; i++) {
+            if (i > 0) {
+                json += pick(2) ? "," : ", ";
+            }
+            value(json, path + "[]", depth + 1);
+        }
+        json += "]";
+    }
+
+    void string(std::string &json, const std::string &path, int depth)
+    {
+        std::string decoded;
+        json += '"';
+        // Mostly short, sometimes past TELEGRAM_JSON_VALUE_MAX
+        uint32_t chars = pick(10) ? pick(40) : TELEGRAM_JSON_VALUE_MAX / 2 + pick(TELEGRAM_JSON_VALUE_MAX);
+        std::vector<size_t> boundaries;
+        for (uint32_t i = 0; i < chars; i++) {
+            boundaries.push_back(decoded.size());
+            uint32_t kind = pick(10);
+            if (kind < 4) {
+                char c = "abcXYZ 019:/.,"[pick(14)];
+                json += c;
+                decoded += c;
+            } else if (kind == 4) {
+                static const char *escapes[][2] = {{"\\\"", "\""}, {"\\\\", "\\"}, {"\\/", "/"}, {"\\n", "\n"},
+                                                   {"\\t", "\t"},  {"\\b", "\b"},  {"\\u0001", "\x01"}};
+                uint32_t e = pick(7);
+                json += escapes[e][0];
+                decoded += escapes[e][1];
+            } else if (kind < 8) {
+                // Raw UTF-8, two to four bytes
+                static const uint32_t codepoints[] = {0xE9, 0x416, 0x20AC, 0x4E2D, 0x1F4E1, 0x1F600};
+                uint32_t cp = codepoints[pick(6)];
+                appendUtf8(json, cp);
+                appendUtf8(decoded, cp);
+            } else if (kind == 8) {
+                uint32_t cp = 0x80 + pick(0xD800 - 0x80);
+                char escape[8];
+                snprintf(escape, sizeof(escape), pick(2) ? "\\u%04x" : "\\u%04X", cp);
+                json += escape;
+                appendUtf8(decoded, cp);
+            } else {
+                // An astral character as a surrogate pair
+                uint32_t cp = 0x10000 + pick(0x100000);
+                char escape[16];
+                snprintf(escape, sizeof(escape), "\\u%04X\\u%04x", 0xD800 + ((cp - 0x10000) >> 10),
+                         0xDC00 + ((cp - 0x10000) & 0x3FF));
+                json += escape;
+                appendUtf8(decoded, cp);
+            }
+        }
+        json += '"';
+
+        // Cut at the last character boundary that fits
+        bool truncated = decoded.size() > TELEGRAM_JSON_VALUE_MAX;
+        if (truncated) {
+            size_t cut = 0;
+            for (size_t b : boundaries) {
+                if (b <= TELEGRAM_JSON_VALUE_MAX) {
+                    cut = b;
+                }
+            }
+            if (boundaries.empty() || decoded.size() <= TELEGRAM_JSON_VALUE_MAX) {
+                cut = decoded.size();
+            }
+            decoded.resize(cut);
+        }
+        _expected->push_back({path, JsonToken::STRING, decoded, truncated, depth});
+    }
+
+    std::mt19937 _rng;
+    std::vector<Expected> *_expected;
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_random_documents_in_random_chunks(void)
+{
+    std::mt19937 rng(11);
+    size_t values = 0;
+    for (uint32_t seed = 0; seed < 2000; seed++) {
+        CheckingHandler handler;
+        Generator generator(seed);
+        std::string json = generator.document(handler.expected);
+
+        TelegramJsonReader reader(handler);
+        for (size_t pos = 0; pos < json.size();) {
+            size_t chunk = std::min<size_t>(1 + rng() % 64, json.size() - pos);
+            TEST_ASSERT_TRUE_MESSAGE(reader.feed(json.data() + pos, chunk), json.c_str());
+            pos += chunk;
+        }
+        TEST_ASSERT_TRUE_MESSAGE(reader.done(), json.c_str());
+        TEST_ASSERT_TRUE_MESSAGE(handler.ok, json.c_str());
+        TEST_ASSERT_EQUAL_size_t(handler.expected.size(), handler.seen);
+        values += handler.seen;
+    }
+    TEST_ASSERT_GREATER_THAN(10000, values);
+}
+
+static bool parses(const char *json)
+{
+    CheckingHandler handler;
+    handler.ok = false;
+    TelegramJsonReader reader(handler);
+    return reader.feed(json, strlen(json)) && reader.done();
+}
+
+static void test_rejects_malformed_input(void)
+{
+    TEST_ASSERT_TRUE(parses("{\"ok\":true}"));
+    TEST_ASSERT_FALSE(parses("{\"ok\":tru}"));
+    TEST_ASSERT_FALSE(parses("{\"ok\" true}"));
+    TEST_ASSERT_FALSE(parses("{\"text\":\"a\\qb\"}"));
+    TEST_ASSERT_FALSE(parses("{\"text\":\"\\u12G4\"}"));
+    TEST_ASSERT_FALSE(parses("{\"text\":\"line\nbreak\"}"));
+    TEST_ASSERT_FALSE(parses("[1,2]]"));
+    TEST_ASSERT_FALSE(parses("{\"ok\":true"));
+
+    std::string deep(TELEGRAM_JSON_NEST_MAX + 1, '[');
+    deep += std::string(TELEGRAM_JSON_NEST_MAX + 1, ']');
+    TEST_ASSERT_FALSE(parses(deep.c_str()));
+}
+
+// Copies the fields TelegramLongPoller wants, the way it does
+class UpdatesHandler : public TelegramJsonHandler
+{
+  public:
+    uint32_t updates = 0;
+    uint32_t texts = 0;
+
+    void onValue(const TelegramJsonReader &reader, JsonToken type, const char *value, size_t len,
+                 bool truncated) override
+    {
+        if (reader.pathIs("result[].update_id")) {
+            updates++;
+        } else if (reader.pathIs("result[].message.text")) {
+            texts++;
+        }
+    }
+};
+
+static void test_throughput_on_get_updates(void)
+{
+    std::string body = "{\"ok\":true,\"result\":[";
+    for (int i = 0; i < 20; i++) {
+        char update[512];
+        snprintf(update, sizeof(update),
+                 "%s{\"update_id\":8754%05d,\"message\":{\"message_id\":%d,\"from\":{\"id\":123456789,"
+                 "\"is_bot\":false,\"first_name\":\"Ana\",\"username\":\"ana_r\",\"language_code\":\"en\"},"
+                 "\"chat\":{\"id\":-1001234567890,\"title\":\"Mesh \\u00e9quipe\",\"type\":\"supergroup\"},"
+                 "\"date\":17000%05d,\"text\":\"Message %d for the mesh \\ud83d\\udce1 with some words\"}}",
+                 i ? "," : "", i, 100 + i, i, i);
+        body += update;
+    }
+    body += "]}";
+
+    UpdatesHandler handler;
+    TelegramJsonReader reader(handler);
+    const int rounds = 500;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        reader.reset();
+        // Socket reads come in small pieces
+        for (size_t pos = 0; pos < body.size(); pos += 64) {
+            reader.feed(body.data() + pos, std::min<size_t>(64, body.size() - pos));
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char line[128];
+    snprintf(line, sizeof(line), "%u-byte getUpdates body: %.1f MB/s, reader state %u bytes", (unsigned)body.size(),
+             body.size() * rounds / seconds / 1e6, (unsigned)sizeof(TelegramJsonReader));
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(reader.done());
+    TEST_ASSERT_EQUAL_UINT32(20 * rounds, handler.updates);
+    TEST_ASSERT_EQUAL_UINT32(20 * rounds, handler.texts);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_random_documents_in_random_chunks);
+    RUN_TEST(test_rejects_malformed_input);
+    RUN_TEST(test_throughput_on_get_updates);
+    return UNITY_END();
+}
@@ -0,0 +1,334 @@
+// Position suppression and live locations over a 12-hour position trace: fixed nodes with GPS
+// noise, a walker, a car and a node carried to a new site. Location messages only on first sight,
+// a real move or the periodic report; smaller moves edit one live location per node; the chat
+// ends up showing where every node is. The fixed-point distance against a double haversine.
+//
+// Gateway below mirrors TelegramModule::forwardPosition and serviceLiveLocations, with the chat
+// reduced to the positions its messages show.
+
+#include "TelegramGeo.h"
+#include "TelegramLiveLocation.h"
+#include "TelegramRateLimiter.h"
+#include <cmath>
+#include <deque>
+#include <map>
+#include <random>
+#include <unity.h>
+#include <vector>
+
+#define TRACE_MS (12 * 3600000UL)
+#define STEP_MS 1000
+#define BASE_LAT_I 523700000 // Around 52.37 N, 4.90 E
+#define BASE_LON_I 49000000
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static double haversineM(int32_t lat1I, int32_t lon1I, int32_t lat2I, int32_t lon2I)
+{
+    const double r = 6371008, rad = M_PI / 180 / 1e7;
+    double dLat = (lat2I - lat1I) * rad, dLon = (lon2I - lon1I) * rad;
+    double a = std::pow(std::sin(dLat / 2), 2) + std::cos(lat1I * rad) * std::cos(lat2I * rad) * std::pow(std::sin(dLon / 2), 2);
+    return 2 * r * std::asin(std::sqrt(a));
+}
+
+// Metres north and east of a point, in 1e-7 degrees
+static int32_t northE7(double metres)
+{
+    return (int32_t)std::lround(metres / 111195.0 * 1e7);
+}
+
+static int32_t eastE7(double metres, int32_t latI)
+{
+    return (int32_t)std::lround(metres / (111195.0 * std::cos(latI * M_PI / 180 / 1e7)) * 1e7);
+}
+
+struct Position {
+    NodeNum num;
+    int32_t latitudeI;
+    int32_t longitudeI;
+};
+
+// The per-node part of TrackedNode forwardPosition uses
+struct Tracked {
+    bool hasReported = false;
+    uint32_t reportedAt = 0;
+    int32_t reportedLatI = 0, reportedLonI = 0;
+    int32_t liveLatI = 0, liveLonI = 0;
+};
+
+struct Chat {
+    std::map<int32_t, Position> shown; // message id -> position the message shows
+    int32_t nextId = 1;
+    uint32_t messages = 0;             // New messages, location or live
+    uint32_t edits = 0;
+};
+
+struct Gateway {
+    std::map<NodeNum, Tracked> tracked;
+    std::deque<Position> outbox; // Location messages waiting for a token
+    TelegramLiveLocations live;
+    TelegramRateLimiter limiter;
+    Chat chat;
+    std::map<NodeNum, uint32_t> reportsOf;
+    uint32_t reported = 0, liveMoves = 0, suppressed = 0;
+
+    void forwardPosition(const Position &pos, uint32_t now)
+    {
+        Tracked &t = tracked[pos.num];
+        bool report = !t.hasReported || now - t.reportedAt >= TELEGRAM_POSITION_REPORT_MS ||
+                      telegramDistanceM(t.reportedLatI, t.reportedLonI, pos.latitudeI, pos.longitudeI) >=
+                          TELEGRAM_POSITION_MOVE_M;
+        bool moved =
+            report || telegramDistanceM(t.liveLatI, t.liveLonI, pos.latitudeI, pos.longitudeI) >= TELEGRAM_POSITION_JITTER_M;
+        if (report) {
+            t.hasReported = true;
+            t.reportedAt = now;
+            t.reportedLatI = pos.latitudeI;
+            t.reportedLonI = pos.longitudeI;
+            reported++;
+            reportsOf[pos.num]++;
+            outbox.push_back(pos);
+        }
+        if (moved) {
+            t.liveLatI = pos.latitudeI;
+            t.liveLonI = pos.longitudeI;
+            if (!report) {
+                liveMoves++;
+            }
+            live.update(pos.num, pos.latitudeI, pos.longitudeI, now);
+        } else {
+            suppressed++;
+        }
+    }
+
+    // The network task: the outbox first, then live locations, both on the one token bucket
+    void netStep(uint32_t now)
+    {
+        while (!outbox.empty() && limiter.tryAcquire(now)) {
+            chat.shown[chat.nextId++] = outbox.front();
+            chat.messages++;
+            outbox.pop_front();
+        }
+        LiveLocation *entry;
+        while (outbox.empty() && (entry = live.nextPending()) != nullptr && limiter.tryAcquire(now)) {
+            Position pos = {entry->num, entry->latitudeI, entry->longitudeI};
+            if (live.isLive(*entry, now)) {
+                chat.shown[entry->messageId] = pos;
+                chat.edits++;
+                live.edited(*entry);
+            } else {
+                chat.shown[chat.nextId] = pos;
+                chat.messages++;
+                live.started(*entry, chat.nextId++, now);
+            }
+        }
+    }
+};
+
+// A node on the trace: where it is at a given time and how often it broadcasts
+struct Mover {
+    NodeNum num;
+    uint32_t intervalMs;
+    uint32_t phaseMs;
+    int32_t (*path)(uint32_t now, int32_t *lonI); // Returns latitudeI
+};
+
+static int32_t walker(uint32_t now, int32_t *lonI)
+{
+    // 1.3 m/s around a 3 km loop, eight hours, then home
+    double s = std::min(now, 8 * 3600000u) / 1000.0 * 1.3;
+    double a = s / 3000 * 2 * M_PI;
+    int32_t latI = BASE_LAT_I + northE7(477 * std::sin(a));
+    *lonI = BASE_LON_I + eastE7(477 * (1 - std::cos(a)), latI);
+    return latI;
+}
+
+static int32_t car(uint32_t now, int32_t *lonI)
+{
+    // 15 m/s east for 40 minutes from the fourth hour, then parked 36 km away
+    uint32_t start = 4 * 3600000u;
+    double s = now < start ? 0 : std::min(now - start, 2400000u) / 1000.0 * 15;
+    int32_t latI = BASE_LAT_I - northE7(2000);
+    *lonI = BASE_LON_I + eastE7(s, latI);
+    return latI;
+}
+
+static int32_t relocated(uint32_t now, int32_t *lonI)
+{
+    // Carried 2 km north at 6 h 10 min
+    int32_t latI = BASE_LAT_I + northE7(now < 22200000u ? 3000 : 5000);
+    *lonI = BASE_LON_I - eastE7(1500, latI);
+    return latI;
+}
+
+static void test_distance_against_double_haversine(void)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int32_t> lat(-600000000, 600000000), lon(-1200000000, 1200000000);
+    std::uniform_real_distribution<double> bearing(0, 2 * M_PI), logDistance(0, std::log(3000000.0));
+    double worstNear = 0, worstFar = 0;
+    for (int i = 0; i < 20000; i++) {
+        int32_t lat1 = lat(rng), lon1 = lon(rng);
+        double d = std::exp(logDistance(rng)), b = bearing(rng);
+        int32_t lat2 = lat1 + northE7(d * std::cos(b));
+        int32_t lon2 = lon1 + eastE7(d * std::sin(b), lat1);
+        double expected = haversineM(lat1, lon1, lat2, lon2);
+        double error = std::fabs(telegramDistanceM(lat1, lon1, lat2, lon2) - expected);
+        if (expected < 1000) {
+            worstNear = std::max(worstNear, error);
+        } else {
+            worstFar = std::max(worstFar, error / expected);
+        }
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "worst error: %.2f m below 1 km, %.4f%% up to 3000 km", worstNear, worstFar * 100);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(worstNear < 1.5); // Whole metres, rounded down
+    TEST_ASSERT_TRUE(worstFar <= 0.001);
+    TEST_ASSERT_EQUAL_UINT32(0, telegramDistanceM(BASE_LAT_I, BASE_LON_I, BASE_LAT_I, BASE_LON_I));
+}
+
+static void test_twelve_hour_trace(void)
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<double> noise(0, 6); // Metres of GPS scatter on every fix
+    std::vector<Mover> movers;
+    for (NodeNum num = 1; num <= 10; num++) {
+        movers.push_back({num, 900000, num * 61000, nullptr}); // Fixed nodes every 15 minutes
+    }
+    movers.push_back({20, 120000, 0, walker});
+    movers.push_back({21, 30000, 5000, car});
+    movers.push_back({22, 900000, 300000, relocated});
+
+    Gateway gw;
+    std::map<NodeNum, Position> last; // Newest position heard from each node
+    std::map<NodeNum, uint32_t> heard;
+    uint32_t positions = 0;
+    for (uint32_t now = 0; now <= TRACE_MS; now += STEP_MS) {
+        for (const Mover &m : movers) {
+            if ((now + m.phaseMs) % m.intervalMs != 0) {
+                continue;
+            }
+            Position pos = {m.num, 0, 0};
+            if (m.path) {
+                pos.latitudeI = m.path(now, &pos.longitudeI);
+            } else {
+                pos.latitudeI = BASE_LAT_I + northE7(400.0 * m.num);
+                pos.longitudeI = BASE_LON_I + eastE7(-300.0 * m.num, pos.latitudeI);
+            }
+            pos.latitudeI += northE7(noise(rng));
+            pos.longitudeI += eastE7(noise(rng), pos.latitudeI);
+            gw.forwardPosition(pos, now);
+            last[m.num] = pos;
+            heard[m.num]++;
+            positions++;
+        }
+        gw.netStep(now);
+    }
+    for (uint32_t now = TRACE_MS; gw.live.nextPending() || !gw.outbox.empty(); now += STEP_MS) {
+        gw.netStep(now);
+    }
+
+    // Every node's live location, or failing that its newest location message, is within
+    // jitter of where it last was
+    for (const auto &kv : last) {
+        double best = 1e9;
+        for (const auto &shown : gw.chat.shown) {
+            if (shown.second.num == kv.first) {
+                best = std::min(best, haversineM(shown.second.latitudeI, shown.second.longitudeI,
+                                                 kv.second.latitudeI, kv.second.longitudeI));
+            }
+        }
+        TEST_ASSERT_TRUE(best < TELEGRAM_POSITION_JITTER_M);
+    }
+
+    // Fixed nodes: first sight and the 6- and 12-hour reports out of 48 broadcasts each
+    for (NodeNum num = 1; num <= 10; num++) {
+        TEST_ASSERT_EQUAL_UINT32(48, heard[num]);
+        TEST_ASSERT_TRUE(gw.reportsOf[num] <= 3);
+    }
+    // The relocated node: once more on arrival, plus the 6-hour report
+    TEST_ASSERT_TRUE(gw.reportsOf[22] <= 3);
+    // The car covers 450 m between fixes, so every other fix of its 36 km drive posts
+    TEST_ASSERT_TRUE(gw.reportsOf[21] >= 40 && gw.reportsOf[21] <= 44);
+    uint32_t newMessages = gw.chat.messages;
+    TEST_ASSERT_EQUAL_UINT32(gw.reported + gw.live.stats().started, newMessages);
+    TEST_ASSERT_EQUAL_UINT32(movers.size(), gw.live.stats().started);
+    TEST_ASSERT_EQUAL_UINT32(0, gw.live.stats().evicted);
+    TEST_ASSERT_TRUE(newMessages * 10 < positions);
+
+    char line[240];
+    snprintf(line, sizeof(line),
+             "%u positions from %u nodes in 12 h: %u location messages and %u live locations with %u edits "
+             "(%u coalesced) instead of %u messages; %u dropped as jitter",
+             positions, (unsigned)movers.size(), gw.reported, gw.live.stats().started, gw.chat.edits,
+             gw.live.stats().coalesced, positions, gw.suppressed);
+    TEST_MESSAGE(line);
+}
+
+static void test_fixed_node_posts_once_per_report_period(void)
+{
+    Gateway gw;
+    Position pos = {5, BASE_LAT_I, BASE_LON_I};
+    for (uint32_t now = 0; now < TELEGRAM_POSITION_REPORT_MS; now += 60000) {
+        pos.latitudeI = BASE_LAT_I + northE7((now / 60000 % 5) * 3.0); // Up to 12 m of scatter
+        gw.forwardPosition(pos, now);
+        gw.netStep(now);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, gw.reported);
+    TEST_ASSERT_EQUAL_UINT32(0, gw.liveMoves);
+    gw.forwardPosition(pos, TELEGRAM_POSITION_REPORT_MS);
+    TEST_ASSERT_EQUAL_UINT32(2, gw.reported);
+}
+
+static void test_move_past_threshold_posts_again(void)
+{
+    Gateway gw;
+    Position pos = {9, BASE_LAT_I, BASE_LON_I};
+    gw.forwardPosition(pos, 0);
+    pos.latitudeI = BASE_LAT_I + northE7(TELEGRAM_POSITION_MOVE_M - 20);
+    gw.forwardPosition(pos, 60000);
+    TEST_ASSERT_EQUAL_UINT32(1, gw.reported);
+    TEST_ASSERT_EQUAL_UINT32(1, gw.liveMoves);
+    pos.latitudeI = BASE_LAT_I + northE7(TELEGRAM_POSITION_MOVE_M + 20);
+    gw.forwardPosition(pos, 120000);
+    TEST_ASSERT_EQUAL_UINT32(2, gw.reported);
+    TEST_ASSERT_EQUAL_UINT32(1, gw.liveMoves);
+}
+
+static void test_positions_waiting_for_a_token_coalesce(void)
+{
+    Gateway gw;
+    Position pos = {7, BASE_LAT_I, BASE_LON_I};
+    gw.forwardPosition(pos, 0);
+    gw.netStep(0); // The location message and the live location take two of the three tokens
+    TEST_ASSERT_EQUAL_UINT32(2, gw.chat.messages);
+    TEST_ASSERT_TRUE(gw.limiter.tryAcquire(0));
+
+    for (int i = 1; i <= 5; i++) {
+        pos.latitudeI = BASE_LAT_I + northE7(60.0 * i);
+        gw.forwardPosition(pos, 100 * i);
+        gw.netStep(100 * i);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, gw.chat.edits);
+    TEST_ASSERT_EQUAL_UINT32(4, gw.live.stats().coalesced);
+
+    uint32_t now = 500 + gw.limiter.msUntilReady(500);
+    gw.netStep(now);
+    TEST_ASSERT_EQUAL_UINT32(1, gw.chat.edits);
+    TEST_ASSERT_NULL(gw.live.nextPending());
+    TEST_ASSERT_EQUAL_INT32(pos.latitudeI, gw.chat.shown[2].latitudeI);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_distance_against_double_haversine);
+    RUN_TEST(test_twelve_hour_trace);
+    RUN_TEST(test_fixed_node_posts_once_per_report_period);
+    RUN_TEST(test_move_past_threshold_posts_again);
+    RUN_TEST(test_positions_waiting_for_a_token_coalesce);
+    return UNITY_END();
+}
@@ -0,0 +1,436 @@
+// TelegramMemory: pressure levels with hysteresis, TLS record buffers handed out by smallest fit
+// with the heap behind them, handshake admission; a 30-day soak on a modelled ESP32 heap with
+// WiFi churn, reconnects and batched sends, the old heap-only build against the pooled one, with
+// fragmentation that must not creep up over the month
+//
+// Gateway below mirrors the heap-facing parts of TelegramModule's network task: the heap sample,
+// shedding telemetry while not NORMAL, closing the long poll at CRITICAL and reconnecting it
+// TELEGRAM_POLL_RESUME_DELAY later, and TelegramTlsClient's admission check. mbedTLS is modelled
+// by the allocations a session and a handshake make.
+
+#include "HostHeap.h"
+#include "TelegramMemory.h"
+#include <algorithm>
+#include <esp_heap_caps.h>
+#include <map>
+#include <mbedtls/platform.h>
+#include <random>
+#include <unity.h>
+#include <vector>
+
+#define TLS_IN_ALLOC 16717           // What mbedTLS asks for its record buffers
+#define TLS_OUT_ALLOC 4429
+#define POLL_RESUME_DELAY_S 60       // TELEGRAM_POLL_RESUME_DELAY in TelegramModule.cpp
+#define SEND_BATCH_S 3               // Forwards gathered before a send
+#ifndef SOAK_DAYS
+#define SOAK_DAYS 30
+#endif
+#define SOAK_HEAP 92160              // Internal heap left to the gateway, the level that made handshakes fail
+
+static TelegramMemory *memory;
+
+void setUp(void)
+{
+    hostHeap = new HostHeap(200000);
+    memory = new TelegramMemory();
+}
+
+void tearDown(void)
+{
+    delete memory;
+    delete hostHeap;
+    hostHeap = nullptr;
+}
+
+static void test_pressure_levels_with_hysteresis(void)
+{
+    memory->begin();
+    TEST_ASSERT_EQUAL(HeapPressure::NORMAL, memory->update(60000, 30000));
+    TEST_ASSERT_EQUAL(HeapPressure::TIGHT, memory->update(TELEGRAM_HEAP_TIGHT - 1, 30000));
+    // Back above the threshold, but not by the margin
+    TEST_ASSERT_EQUAL(HeapPressure::TIGHT, memory->update(TELEGRAM_HEAP_TIGHT + 1000, 30000));
+    TEST_ASSERT_EQUAL(HeapPressure::NORMAL, memory->update(TELEGRAM_HEAP_TIGHT + TELEGRAM_HEAP_HYSTERESIS, 30000));
+    // Fragmentation alone, with plenty free
+    TEST_ASSERT_EQUAL(HeapPressure::CRITICAL, memory->update(60000, TELEGRAM_HEAP_CRITICAL_BLOCK - 144));
+    TEST_ASSERT_EQUAL(HeapPressure::CRITICAL, memory->update(60000, TELEGRAM_HEAP_CRITICAL_BLOCK + 1856));
+    TEST_ASSERT_EQUAL(HeapPressure::TIGHT, memory->update(60000, 10240));
+    TEST_ASSERT_EQUAL(HeapPressure::NORMAL, memory->update(60000, 16384));
+    TEST_ASSERT_EQUAL_UINT32(2, memory->heap().tight);
+    TEST_ASSERT_EQUAL_UINT32(1, memory->heap().critical);
+    TEST_ASSERT_EQUAL_UINT32(TELEGRAM_HEAP_CRITICAL_BLOCK - 144, memory->heap().lowestLargest);
+
+    // sample() reads the heap
+    hostHeap->alloc(hostHeap->freeBytes() - TELEGRAM_HEAP_CRITICAL);
+    TEST_ASSERT_EQUAL(HeapPressure::CRITICAL, memory->sample());
+}
+
+static void test_tls_buffers_from_the_pool(void)
+{
+    size_t before = hostHeap->freeBytes();
+    memory->begin();
+    TEST_ASSERT_TRUE(hostMbedtlsCalloc == TelegramMemory::tlsCalloc);
+    const PoolStats &tls = memory->pool(MemoryPool::TLS);
+    TEST_ASSERT_EQUAL_UINT32(2 * TELEGRAM_TLS_SESSIONS, tls.capacity);
+    TEST_ASSERT_EQUAL_UINT32(TELEGRAM_TLS_SESSIONS * (TELEGRAM_TLS_IN_BUFFER + TELEGRAM_TLS_OUT_BUFFER), tls.bytes);
+    TEST_ASSERT_TRUE(before - hostHeap->freeBytes() >= tls.bytes);
+
+    // Record buffers by smallest fit, zeroed; small allocations from the heap
+    size_t free = hostHeap->freeBytes();
+    void *out1 = hostMbedtlsCalloc(1, TLS_OUT_ALLOC);
+    void *in1 = hostMbedtlsCalloc(1, TLS_IN_ALLOC);
+    void *small = hostMbedtlsCalloc(10, 100);
+    void *in2 = hostMbedtlsCalloc(TLS_IN_ALLOC, 1);
+    void *out2 = hostMbedtlsCalloc(TLS_OUT_ALLOC, 1);
+    TEST_ASSERT_EQUAL_UINT32(4, tls.inUse);
+    TEST_ASSERT_EQUAL_UINT32(0, tls.failures);
+    TEST_ASSERT_TRUE(in1 != in2 && out1 != out2);
+    TEST_ASSERT_EQUAL_UINT32(free - 1008, hostHeap->freeBytes()); // 1000 bytes and a header
+    TEST_ASSERT_EQUAL_UINT8(0, ((uint8_t *)in1)[TLS_IN_ALLOC - 1]);
+
+    // A third session's buffers come from the heap
+    void *extra = hostMbedtlsCalloc(1, TLS_IN_ALLOC);
+    TEST_ASSERT_NOT_NULL(extra);
+    TEST_ASSERT_EQUAL_UINT32(1, tls.failures);
+    TEST_ASSERT_TRUE(free - hostHeap->freeBytes() > TLS_IN_ALLOC);
+
+    hostMbedtlsFree(extra);
+    hostMbedtlsFree(small);
+    hostMbedtlsFree(in2);
+    hostMbedtlsFree(out2);
+    TEST_ASSERT_EQUAL_UINT32(2, tls.inUse);
+    TEST_ASSERT_EQUAL_UINT32(4, tls.highWater);
+    TEST_ASSERT_EQUAL_UINT32(free, hostHeap->freeBytes());
+    hostMbedtlsFree(in1);
+    hostMbedtlsFree(out1);
+    TEST_ASSERT_EQUAL_UINT32(0, tls.inUse);
+}
+
+static void test_handshake_admission(void)
+{
+    memory->begin();
+    // Spare buffers: the handshake itself is all the heap has to take
+    TEST_ASSERT_TRUE(memory->admitTls(TELEGRAM_TLS_HANDSHAKE_HEAP, TELEGRAM_TLS_HANDSHAKE_BLOCK));
+    TEST_ASSERT_FALSE(memory->admitTls(TELEGRAM_TLS_HANDSHAKE_HEAP - 1, 60000));
+    TEST_ASSERT_FALSE(memory->admitTls(60000, TELEGRAM_TLS_HANDSHAKE_BLOCK - 1));
+
+    // Both pairs taken: the record buffers need room on the heap too, the incoming one in one piece
+    void *in1 = hostMbedtlsCalloc(1, TLS_IN_ALLOC), *out1 = hostMbedtlsCalloc(1, TLS_OUT_ALLOC);
+    void *in2 = hostMbedtlsCalloc(1, TLS_IN_ALLOC), *out2 = hostMbedtlsCalloc(1, TLS_OUT_ALLOC);
+    uint32_t bothBuffers = TELEGRAM_TLS_HANDSHAKE_HEAP + TELEGRAM_TLS_IN_BUFFER + TELEGRAM_TLS_OUT_BUFFER;
+    TEST_ASSERT_FALSE(memory->admitTls(bothBuffers - 1, TELEGRAM_TLS_IN_BUFFER));
+    TEST_ASSERT_FALSE(memory->admitTls(bothBuffers, TELEGRAM_TLS_IN_BUFFER - 1));
+    TEST_ASSERT_TRUE(memory->admitTls(bothBuffers, TELEGRAM_TLS_IN_BUFFER));
+
+    // A spare outgoing buffer only: just the incoming one's room
+    hostMbedtlsFree(out2);
+    TEST_ASSERT_TRUE(memory->admitTls(TELEGRAM_TLS_HANDSHAKE_HEAP + TELEGRAM_TLS_IN_BUFFER, TELEGRAM_TLS_IN_BUFFER));
+    TEST_ASSERT_EQUAL_UINT32(4, memory->heap().tlsRefused);
+
+    // admitTls() takes a fresh reading of the heap
+    hostMbedtlsFree(in2);
+    void *hog = hostHeap->alloc(hostHeap->freeBytes() - TELEGRAM_TLS_HANDSHAKE_HEAP);
+    TEST_ASSERT_FALSE(memory->admitTls());
+    hostHeap->free(hog);
+    TEST_ASSERT_TRUE(memory->admitTls());
+    hostMbedtlsFree(in1);
+    hostMbedtlsFree(out1);
+}
+
+// Arduino String's growth: capacity in 16-byte steps, a realloc for every step
+struct HeapString {
+    void *buffer = nullptr;
+    size_t capacity = 0;
+
+    bool grow(size_t length)
+    {
+        for (size_t step = capacity + 16; step <= length + 16; step += 16) {
+            void *moved = hostHeap->realloc(buffer, step);
+            if (!moved) {
+                return false;
+            }
+            buffer = moved;
+            capacity = step;
+        }
+        return true;
+    }
+
+    ~HeapString() { hostHeap->free(buffer); }
+};
+
+struct SoakResult {
+    uint32_t handshakes = 0;
+    uint32_t handshakeFailures = 0;
+    uint32_t deferred = 0;
+    uint32_t sends = 0;
+    uint32_t sendsFailed = 0;
+    uint32_t shed = 0;
+    uint32_t suspended = 0;
+    size_t lowestLargest = SIZE_MAX;
+    double fragmentation[SOAK_DAYS] = {}; // Mean 1 - largest/free per day, with both sessions up
+};
+
+struct Gateway {
+    // An mbedTLS session: what it keeps while connected
+    struct Session {
+        bool up = false;
+        std::vector<void *> kept;
+    };
+
+    bool pooled;
+    std::mt19937 rng;
+    SoakResult result;
+    Session send, poll;
+    std::multimap<uint32_t, void *> timed; // Expiry second -> allocation of the rest of the firmware
+    bool suspended = false;
+    uint32_t resumeAt = 0;
+    uint32_t queued = 0, queuedBytes = 0, batchAt = 0;
+    uint32_t samplesToday = 0;
+
+    Gateway(bool pooled, uint32_t seed) : pooled(pooled), rng(seed)
+    {
+        if (pooled) {
+            memory->begin();
+        }
+    }
+
+    ~Gateway()
+    {
+        close(send);
+        close(poll);
+        for (auto &t : timed) {
+            hostHeap->free(t.second);
+        }
+    }
+
+    uint32_t between(uint32_t lo, uint32_t hi) { return std::uniform_int_distribution<uint32_t>(lo, hi)(rng); }
+    bool chance(double p) { return std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+
+    void *tlsAlloc(size_t bytes) { return pooled ? hostMbedtlsCalloc(1, bytes) : heap_caps_calloc(1, bytes, 0); }
+    void tlsFree(void *ptr) { pooled ? hostMbedtlsFree(ptr) : heap_caps_free(ptr); }
+
+    void close(Session &s)
+    {
+        for (void *p : s.kept) {
+            tlsFree(p);
+        }
+        s.kept.clear();
+        s.up = false;
+    }
+
+    // Context and config, the record buffers, then the handshake's temporaries (key exchange,
+    // certificate parsing) of which the peer's chain is kept: about 20KB at the peak
+    bool handshake(Session &s)
+    {
+        if (pooled && !memory->admitTls()) {
+            result.deferred++;
+            return false;
+        }
+        std::vector<void *> temporary;
+        bool ok = true;
+        auto take = [&](size_t bytes, std::vector<void *> &into) {
+            void *p = ok ? tlsAlloc(bytes) : nullptr;
+            ok = p != nullptr;
+            if (ok) {
+                into.push_back(p);
+            }
+        };
+        take(between(380, 420), s.kept);
+        take(between(280, 320), s.kept);
+        take(TLS_IN_ALLOC, s.kept);
+        take(TLS_OUT_ALLOC, s.kept);
+        for (int i = 0; i < 14 && ok; i++) {
+            take(between(200, 2600), temporary);
+            if (i % 5 == 4) {
+                take(between(1200, 1700), s.kept);
+            }
+            if (temporary.size() > 6) {
+                tlsFree(temporary.front());
+                temporary.erase(temporary.begin());
+            }
+        }
+        for (void *p : temporary) {
+            tlsFree(p);
+        }
+        result.handshakes++;
+        if (!ok) {
+            result.handshakeFailures++;
+            close(s);
+            return false;
+        }
+        s.up = true;
+        return true;
+    }
+
+    // A batched send: lwIP pbufs for the request; the old build also grew the body, the headers
+    // and the reply in Strings, where TelegramPoster streams through a fixed buffer
+    bool sendBatch()
+    {
+        size_t body = std::min<uint32_t>(queuedBytes + 60, 4200);
+        HeapString out, head, reply;
+        bool ok = pooled || out.grow(body);
+        std::vector<void *> pbufs;
+        for (size_t n = 0; n < (body + 1435) / 1436 && ok; n++) {
+            void *p = hostHeap->alloc(1600);
+            ok = p != nullptr;
+            if (ok) {
+                pbufs.push_back(p);
+            }
+        }
+        if (!pooled && ok) {
+            ok = head.grow(between(330, 380)) && reply.grow(body + between(200, 300));
+        }
+        for (void *p : pbufs) {
+            hostHeap->free(p);
+        }
+        return ok;
+    }
+
+    void second(uint32_t t)
+    {
+        for (auto it = timed.begin(); it != timed.end() && it->first <= t; it = timed.erase(it)) {
+            hostHeap->free(it->second);
+        }
+        HeapPressure level = pooled ? memory->sample() : HeapPressure::NORMAL;
+
+        // WiFi and lwIP buffers for a moment, and now and then something that stays a while
+        for (int i = 0; i < 2; i++) {
+            void *p = hostHeap->alloc(between(64, 1600));
+            if (p) {
+                timed.emplace(t + between(0, 2), p);
+            }
+        }
+        if (chance(1.0 / 60)) {
+            void *p = hostHeap->alloc(between(32, 512));
+            if (p) {
+                timed.emplace(t + 1 + (uint32_t)std::exponential_distribution<double>(1.0 / 3600)(rng), p);
+            }
+        }
+
+        // Mesh text, and telemetry reports that are shed under pressure
+        if (chance(1.0 / 45)) {
+            queued++;
+            queuedBytes += between(120, 380);
+            batchAt = batchAt ? batchAt : t + SEND_BATCH_S;
+        }
+        if (chance(1.0 / 120)) {
+            if (level != HeapPressure::NORMAL) {
+                result.shed++;
+            } else {
+                queued++;
+                queuedBytes += between(150, 300);
+                batchAt = batchAt ? batchAt : t + SEND_BATCH_S;
+            }
+        }
+
+        // Servers and WiFi drop sessions now and then
+        if (send.up && chance(1.0 / 600)) {
+            close(send);
+        }
+        if (poll.up && chance(1.0 / 1800)) {
+            close(poll);
+        }
+
+        if (level == HeapPressure::CRITICAL) {
+            if (!suspended) {
+                close(poll);
+                result.suspended++;
+                suspended = true;
+            }
+        } else if (suspended) {
+            suspended = false;
+            resumeAt = t + POLL_RESUME_DELAY_S;
+        } else if (!poll.up && t >= resumeAt) {
+            handshake(poll);
+        } else if (t % 25 == 0) {
+            // A getUpdates answer; the old build's bot parsed it through Strings
+            void *p = hostHeap->alloc(1600);
+            if (p) {
+                timed.emplace(t + 1, p);
+            }
+            if (!pooled) {
+                HeapString headers, text;
+                headers.grow(300);
+                text.grow(between(30, 60));
+            }
+        }
+
+        if (batchAt && t >= batchAt) {
+            bool ok = (send.up || handshake(send)) && sendBatch();
+            result.sends++;
+            if (ok) {
+                queued = queuedBytes = batchAt = 0;
+            } else {
+                result.sendsFailed++;
+                batchAt = t + 10;
+            }
+        }
+
+        if (send.up && poll.up) {
+            size_t largest = hostHeap->largestFree();
+            result.lowestLargest = std::min(result.lowestLargest, largest);
+            result.fragmentation[t / 86400] += 1.0 - (double)largest / hostHeap->freeBytes();
+            samplesToday++;
+        }
+        if (t % 86400 == 86399) {
+            result.fragmentation[t / 86400] /= std::max<uint32_t>(samplesToday, 1);
+            samplesToday = 0;
+        }
+    }
+};
+
+static SoakResult soak(bool pooled)
+{
+    delete hostHeap;
+    hostHeap = new HostHeap(SOAK_HEAP);
+    Gateway gw(pooled, 1);
+    for (uint32_t t = 0; t < SOAK_DAYS * 86400; t++) {
+        gw.second(t);
+    }
+    return gw.result;
+}
+
+static double meanOf(const double *days, int count)
+{
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += days[i];
+    }
+    return sum / count;
+}
+
+static void test_soak_fragmentation_stays_bounded(void)
+{
+    SoakResult results[2];
+    for (int pooled = 0; pooled < 2; pooled++) {
+        SoakResult &r = results[pooled];
+        r = soak(pooled);
+        double first = meanOf(r.fragmentation, SOAK_DAYS / 3);
+        double last = meanOf(r.fragmentation + SOAK_DAYS - SOAK_DAYS / 3, SOAK_DAYS / 3);
+        double worst = *std::max_element(r.fragmentation, r.fragmentation + SOAK_DAYS);
+
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "%s, %u KB heap, %u days: %u handshakes, %u failed, %u deferred; %u of %u sends failed; %u "
+                 "telemetry shed, %u polls suspended; lowest largest block %u; fragmentation %.3f first third, "
+                 "%.3f last third, %.3f worst day",
+                 pooled ? "pooled" : "heap  ", SOAK_HEAP / 1024, SOAK_DAYS, r.handshakes, r.handshakeFailures,
+                 r.deferred, r.sendsFailed, r.sends, r.shed, r.suspended, (unsigned)r.lowestLargest, first, last, worst);
+        TEST_MESSAGE(line);
+
+        // No creep: the last third of the month is no more fragmented than the first
+        TEST_ASSERT_TRUE(last <= first + 0.05);
+        TEST_ASSERT_TRUE(worst < 0.75);
+    }
+    TEST_ASSERT_TRUE(results[1].handshakeFailures < results[0].handshakeFailures);
+    TEST_ASSERT_TRUE(results[1].sendsFailed < results[0].sendsFailed);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pressure_levels_with_hysteresis);
+    RUN_TEST(test_tls_buffers_from_the_pool);
+    RUN_TEST(test_handshake_admission);
+    RUN_TEST(test_soak_fragmentation_stays_bounded);
+    return UNITY_END();
+}
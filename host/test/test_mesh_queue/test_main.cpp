@@ -0,0 +1,254 @@
+// TelegramMeshQueue: fragments that fit a packet and reassemble, UTF-8-safe cuts, airtime pacing
+// and the TX watermark, and a 2 KB message plus a burst of 20 going out in order through a
+// simulated radio without overflowing the Router's TX queue
+
+#include "TelegramMeshQueue.h"
+#include <deque>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+#define TX_QUEUE_MAX 16 // Router's MAX_TX_QUEUE
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Text of about len bytes mixing ASCII, Cyrillic and emoji, never ending inside a character
+static std::string mixedText(size_t len)
+{
+    static const char *words[] = {"hello ", "\xD0\xBC\xD0\xB8\xD1\x80 ", "\xF0\x9F\x98\x80 ", "longerword ", "a "};
+    std::string text;
+    for (int i = 0; text.size() < len; i++) {
+        text += words[i % 5];
+    }
+    text.resize(len);
+    while (!text.empty() && ((uint8_t)text.back() & 0x80)) {
+        text.pop_back();
+    }
+    return text;
+}
+
+static bool startsCharacter(const std::string &s)
+{
+    return s.empty() || ((uint8_t)s[0] & 0xC0) != 0x80;
+}
+
+static bool validUtf8(const std::string &s)
+{
+    for (size_t i = 0; i < s.size();) {
+        uint8_t c = s[i];
+        size_t n = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+        if (n == 0 || i + n > s.size()) {
+            return false;
+        }
+        for (size_t k = 1; k < n; k++) {
+            if (((uint8_t)s[i + k] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += n;
+    }
+    return true;
+}
+
+// Drop the spaces a cut may have swallowed, to compare reassembled text with the original
+static std::string withoutSpaces(const std::string &s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c != ' ') {
+            out += c;
+        }
+    }
+    return out;
+}
+
+static void test_fragments_fit_and_reassemble(void)
+{
+    TelegramMeshQueue queue;
+    std::string text = mixedText(1500);
+    uint8_t fragments = queue.push(text.data(), text.size(), "1", 0, 0);
+    TEST_ASSERT_GREATER_THAN_UINT32(7, fragments);
+
+    std::string joined;
+    char buf[TELEGRAM_MESH_FRAGMENT_MAX + 1];
+    for (uint8_t i = 1; i <= fragments; i++) {
+        size_t len = queue.peek(buf, sizeof(buf));
+        std::string fragment(buf, len);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(TELEGRAM_MESH_FRAGMENT_MAX, len);
+        TEST_ASSERT_TRUE(validUtf8(fragment));
+
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "(%u/%u) ", i, fragments);
+        TEST_ASSERT_EQUAL_INT(0, fragment.compare(0, strlen(prefix), prefix));
+        std::string body = fragment.substr(strlen(prefix));
+        TEST_ASSERT_TRUE(startsCharacter(body));
+        joined += body;
+
+        MeshMessageInfo done;
+        TEST_ASSERT_EQUAL(i == fragments, queue.pop(0, done));
+    }
+    std::string expected = withoutSpaces(text);
+    std::string actual = withoutSpaces(joined);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), actual.c_str());
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+static void test_short_message_goes_as_is(void)
+{
+    TelegramMeshQueue queue;
+    std::string text(TELEGRAM_MESH_FRAGMENT_MAX, 'x');
+    TEST_ASSERT_EQUAL_UINT8(1, queue.push(text.data(), text.size(), "42", 1234, 1700000000));
+    char buf[TELEGRAM_MESH_FRAGMENT_MAX + 1];
+    TEST_ASSERT_EQUAL_UINT32(text.size(), queue.peek(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), buf);
+
+    MeshMessageInfo done;
+    TEST_ASSERT_TRUE(queue.pop(0, done));
+    TEST_ASSERT_EQUAL_STRING("42", done.chatId);
+    TEST_ASSERT_EQUAL_UINT32(1234, done.arrivedAt);
+    TEST_ASSERT_EQUAL_UINT32(1700000000, done.date);
+    TEST_ASSERT_EQUAL_UINT8(1, done.fragments);
+}
+
+static void test_rejects_what_does_not_fit(void)
+{
+    TelegramMeshQueue queue;
+    std::string big(TELEGRAM_MESH_QUEUE_BYTES + 1, 'x');
+    TEST_ASSERT_EQUAL_UINT8(0, queue.push(big.data(), big.size(), "1", 0, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, queue.push("", 0, "1", 0, 0));
+    for (int i = 0; i < TELEGRAM_MESH_QUEUE_MESSAGES; i++) {
+        TEST_ASSERT_EQUAL_UINT8(1, queue.push("hi", 2, "1", 0, 0));
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, queue.push("hi", 2, "1", 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(3, queue.stats().rejected);
+    TEST_ASSERT_EQUAL_UINT32(TELEGRAM_MESH_QUEUE_MESSAGES, queue.size());
+}
+
+static void test_paced_by_airtime_and_watermark(void)
+{
+    TelegramMeshQueue queue;
+    TEST_ASSERT_GREATER_THAN_UINT32(queue.airtimeMs(10), queue.airtimeMs(200));
+    uint32_t longFast = queue.airtimeMs(200);
+    queue.setModem(12, 125000, 8); // LONG_SLOW
+    TEST_ASSERT_GREATER_THAN_UINT32(4 * longFast, queue.airtimeMs(200));
+    queue.setModem(11, 250000, 5);
+
+    queue.push("one", 3, "1", 0, 0);
+    queue.push("two", 3, "1", 0, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.msUntilReady(1000, 0));
+    TEST_ASSERT_GREATER_THAN_UINT32(0, queue.msUntilReady(1000, TELEGRAM_MESH_TX_WATERMARK));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats().held);
+
+    MeshMessageInfo done;
+    queue.pop(1000, done);
+    uint32_t gap = queue.airtimeMs(3) * TELEGRAM_MESH_PACING_PERCENT / 100;
+    TEST_ASSERT_EQUAL_UINT32(gap, queue.msUntilReady(1000, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.msUntilReady(1000 + gap - 1, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, queue.msUntilReady(1000 + gap, 0));
+}
+
+// The Router's TX queue and the radio: one packet on air at a time, each for its airtime
+struct Radio {
+    std::deque<std::string> queued;
+    std::vector<std::string> aired;
+    uint32_t busyUntil = 0;
+    size_t highWater = 0;
+    uint32_t overflows = 0;
+
+    void service(uint32_t now, const TelegramMeshQueue &queue)
+    {
+        if (!queued.empty() && (int32_t)(now - busyUntil) >= 0) {
+            busyUntil = now + queue.airtimeMs(queued.front().size());
+            aired.push_back(queued.front());
+            queued.pop_front();
+        }
+    }
+
+    void send(const char *text, size_t len)
+    {
+        if (queued.size() == TX_QUEUE_MAX) {
+            overflows++;
+            return;
+        }
+        queued.emplace_back(text, len);
+        highWater = std::max(highWater, queued.size());
+    }
+};
+
+static void test_long_message_and_burst_go_out_in_order(void)
+{
+    TelegramMeshQueue queue;
+    Radio radio;
+    std::string big = mixedText(TELEGRAM_MESH_QUEUE_BYTES);
+    uint8_t bigFragments = queue.push(big.data(), big.size(), "1", 0, 0);
+    TEST_ASSERT_GREATER_THAN_UINT32(10, bigFragments);
+
+    // The burst arrives while the long message is going out. What the queue has no room for yet
+    // is refused, as the chat is told; the sender tries again every few seconds.
+    std::vector<std::string> burst;
+    for (int i = 0; i < 20; i++) {
+        burst.push_back("burst message " + std::to_string(i));
+    }
+    size_t nextBurst = 0;
+    uint32_t retries = 0;
+    uint32_t retryAt = 500;
+    std::vector<uint32_t> doneAt;
+
+    uint32_t now = 0;
+    for (; now < 3600000 && (!queue.isEmpty() || !radio.queued.empty() || nextBurst < burst.size()); now += 10) {
+        radio.service(now, queue);
+        if (nextBurst < burst.size() && now >= retryAt) {
+            const std::string &text = burst[nextBurst];
+            if (queue.push(text.data(), text.size(), "1", now, 0) > 0) {
+                nextBurst++;
+            } else {
+                retries++;
+                retryAt = now + 5000;
+            }
+        }
+        if (!queue.isEmpty() && queue.msUntilReady(now, radio.queued.size()) == 0) {
+            char buf[TELEGRAM_MESH_FRAGMENT_MAX + 1];
+            size_t len = queue.peek(buf, sizeof(buf));
+            radio.send(buf, len);
+            MeshMessageInfo done;
+            if (queue.pop(now, done)) {
+                doneAt.push_back(now);
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(bigFragments + burst.size(), radio.aired.size());
+    TEST_ASSERT_EQUAL_UINT32(0, radio.overflows);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(TELEGRAM_MESH_TX_WATERMARK, radio.highWater);
+
+    std::string joined;
+    for (uint8_t i = 0; i < bigFragments; i++) {
+        joined += radio.aired[i].substr(radio.aired[i].find(") ") + 2);
+    }
+    std::string expected = withoutSpaces(big);
+    std::string actual = withoutSpaces(joined);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), actual.c_str());
+    for (size_t i = 0; i < burst.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(burst[i].c_str(), radio.aired[bigFragments + i].c_str());
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line),
+             "2 KB message in %u fragments and 20 short ones: %zu packets in %.1f s, TX queue high water %zu, "
+             "%u pushes refused while full",
+             bigFragments, radio.aired.size(), now / 1000.0, radio.highWater, retries);
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fragments_fit_and_reassemble);
+    RUN_TEST(test_short_message_goes_as_is);
+    RUN_TEST(test_rejects_what_does_not_fit);
+    RUN_TEST(test_paced_by_airtime_and_watermark);
+    RUN_TEST(test_long_message_and_burst_go_out_in_order);
+    return UNITY_END();
+}
@@ -0,0 +1,219 @@
+// TelegramNodeTable's location grid at 5000 nodes: /nearby results against a scan of every node,
+// across the antimeridian and after expiry, and /map clusters within the URL budget; query and
+// clustering cost against the full scan and the unclustered URL they replaced
+
+#include "TelegramGeo.h"
+#include "TelegramNodeTable.h"
+#include "TelegramText.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+#define NODES 5000
+#define TIMEOUT_MS 3600000
+#define MAP_URL_BUDGET 1024 // As in TelegramModule.h
+#define MAP_POINTS ((MAP_URL_BUDGET - 80) / 24)
+
+static TelegramNodeTable table(TIMEOUT_MS);
+
+void setUp(void)
+{
+    table = TelegramNodeTable(TIMEOUT_MS);
+}
+
+void tearDown(void) {}
+
+// 20 towns of 250 nodes, a few km across, spread over about 600 x 600 km; the last town sits on
+// the antimeridian
+static void populate(uint32_t now)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int32_t> spread(-27000000, 27000000);
+    std::normal_distribution<double> scatter(0, 270000);
+    int32_t townLat[20], townLon[20];
+    for (int i = 0; i < 20; i++) {
+        townLat[i] = 480000000 + spread(rng);
+        townLon[i] = 100000000 + spread(rng);
+    }
+    townLat[19] = -170000000;
+    townLon[19] = 1799990000;
+
+    for (NodeNum n = 0; n < NODES; n++) {
+        TrackedNode *node = table.touch(0x10000 + n, now);
+        int town = n % 20;
+        int32_t lon = townLon[town] + (int32_t)scatter(rng);
+        if (lon > 1800000000) {
+            lon -= 3600000000;
+        }
+        table.setLocation(*node, townLat[town] + (int32_t)scatter(rng), lon, 0);
+    }
+}
+
+// What /nearby did before the grid: every located node's distance
+static size_t scanNearby(int32_t latI, int32_t lonI, uint32_t radiusM, std::vector<NearbyNode> &out)
+{
+    out.clear();
+    for (size_t i = 0; i < table.size(); i++) {
+        const TrackedNode &node = table.at(i);
+        if (!node.hasLocation) {
+            continue;
+        }
+        uint32_t d = telegramDistanceM(latI, lonI, node.latitudeI, node.longitudeI);
+        if (d <= radiusM) {
+            out.push_back({(uint16_t)i, d});
+        }
+    }
+    std::sort(out.begin(), out.end(),
+              [](const NearbyNode &a, const NearbyNode &b) { return a.distanceM < b.distanceM; });
+    return out.size();
+}
+
+// TelegramModule::renderMapUrl
+template <size_t N> static void renderMapUrl(TelegramTextBuffer<N> &out, const MapCluster *clusters, size_t count)
+{
+    out.add("https://www.google.com/maps/dir/?api=1&waypoints=");
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) {
+            out.add("|");
+        }
+        out.addDegrees(clusters[i].latSum / clusters[i].count).add(",").addDegrees(clusters[i].lonSum / clusters[i].count);
+    }
+    out.add("&travelmode=driving");
+}
+
+static void test_nearby_matches_a_full_scan(void)
+{
+    populate(0);
+    // Every other node of each town is heard again and moves a little, the rest expire
+    for (NodeNum n = 0; n < NODES; n++) {
+        if (n / 20 % 2 != 0) {
+            continue;
+        }
+        TrackedNode *node = table.touch(0x10000 + n, TIMEOUT_MS / 2);
+        int32_t lon = node->longitudeI - 30000;
+        if (lon < -1800000000) {
+            lon += 3600000000;
+        }
+        table.setLocation(*node, node->latitudeI + 20000, lon, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(NODES / 2, table.expire(TIMEOUT_MS + 2 * TELEGRAM_WHEEL_TICK_MS));
+    TEST_ASSERT_EQUAL_UINT32(NODES / 2, table.withLocation());
+
+    std::mt19937 rng(11);
+    std::vector<NearbyNode> expected;
+    NearbyNode got[10];
+    uint32_t acrossAntimeridian = 0;
+    for (int q = 0; q < 1000; q++) {
+        const TrackedNode &origin = table.at(rng() % table.size());
+        uint32_t radiusM = q % 3 == 0 ? 1000 : q % 3 == 1 ? 5000 : 20000;
+        size_t found = table.nearby(origin.latitudeI, origin.longitudeI, radiusM, got, 10);
+        TEST_ASSERT_EQUAL_UINT32(scanNearby(origin.latitudeI, origin.longitudeI, radiusM, expected), found);
+        for (size_t i = 0; i < std::min(found, (size_t)10); i++) {
+            // Ties may come in either order; the distances may not
+            TEST_ASSERT_EQUAL_UINT32(expected[i].distanceM, got[i].distanceM);
+            const TrackedNode &node = table.at(got[i].index);
+            TEST_ASSERT_EQUAL_UINT32(got[i].distanceM, telegramDistanceM(origin.latitudeI, origin.longitudeI,
+                                                                        node.latitudeI, node.longitudeI));
+            acrossAntimeridian += (origin.longitudeI > 0) != (node.longitudeI > 0);
+        }
+    }
+    TEST_ASSERT_TRUE(acrossAntimeridian > 0);
+}
+
+static void test_map_clusters_fit_the_url_budget(void)
+{
+    populate(0);
+    MapCluster clusters[MAP_POINTS];
+    uint8_t level = 0;
+    size_t count = table.cluster(clusters, MAP_POINTS, level);
+    TEST_ASSERT_TRUE(count >= 4 && count <= MAP_POINTS);
+
+    uint32_t members = 0;
+    for (size_t i = 0; i < count; i++) {
+        members += clusters[i].count;
+    }
+    TEST_ASSERT_EQUAL_UINT32(NODES, members);
+
+    TelegramTextBuffer<MAP_URL_BUDGET + 64> url;
+    renderMapUrl(url, clusters, count);
+    TEST_ASSERT_TRUE(url.length() <= MAP_URL_BUDGET);
+
+    // A handful of nodes need no clustering at all
+    table = TelegramNodeTable(TIMEOUT_MS);
+    for (NodeNum n = 1; n <= 5; n++) {
+        table.setLocation(*table.touch(n, 0), 480000000 + n * 5000000, 100000000, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, table.cluster(clusters, MAP_POINTS, level));
+    TEST_ASSERT_EQUAL_UINT32(0, level);
+}
+
+static void test_benchmark_at_5000_nodes(void)
+{
+    populate(0);
+    using Clock = std::chrono::steady_clock;
+    std::mt19937 rng(3);
+    std::vector<NearbyNode> scanned;
+    NearbyNode got[10];
+
+    for (uint32_t radiusM : {1000u, 5000u, 20000u}) {
+        const int queries = 300;
+        std::vector<const TrackedNode *> origins;
+        for (int q = 0; q < queries; q++) {
+            origins.push_back(&table.at(rng() % table.size()));
+        }
+        size_t inRange = 0;
+        auto start = Clock::now();
+        for (const TrackedNode *o : origins) {
+            inRange += table.nearby(o->latitudeI, o->longitudeI, radiusM, got, 10);
+        }
+        double gridUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queries;
+        start = Clock::now();
+        for (const TrackedNode *o : origins) {
+            scanNearby(o->latitudeI, o->longitudeI, radiusM, scanned);
+        }
+        double scanUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queries;
+        TEST_ASSERT_LESS_THAN(scanUs, gridUs);
+
+        char line[128];
+        snprintf(line, sizeof(line), "/nearby %2u km: %6.1f us grid, %6.1f us full scan, %5.1f nodes in range",
+                 radiusM / 1000, gridUs, scanUs, (double)inRange / queries);
+        TEST_MESSAGE(line);
+    }
+
+    MapCluster clusters[MAP_POINTS];
+    uint8_t level = 0;
+    size_t count = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < 100; i++) {
+        count = table.cluster(clusters, MAP_POINTS, level);
+    }
+    double clusterUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / 100;
+    TelegramTextBuffer<MAP_URL_BUDGET + 64> url;
+    renderMapUrl(url, clusters, count);
+
+    // The URL /map used to build: every located node
+    std::string every = "https://www.google.com/maps/dir/?api=1&waypoints=";
+    for (size_t i = 0; i < table.size(); i++) {
+        TelegramTextBuffer<32> point;
+        point.addDegrees(table.at(i).latitudeI).add(",").addDegrees(table.at(i).longitudeI);
+        every += (i > 0 ? "|" : "") + std::string(point.c_str());
+    }
+    every += "&travelmode=driving";
+
+    char line[160];
+    snprintf(line, sizeof(line), "/map: %u clusters (level %u) in %.1f us, %u byte URL instead of %u bytes",
+             (unsigned)count, level, clusterUs, (unsigned)url.length(), (unsigned)every.size());
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_nearby_matches_a_full_scan);
+    RUN_TEST(test_map_clusters_fit_the_url_budget);
+    RUN_TEST(test_benchmark_at_5000_nodes);
+    return UNITY_END();
+}
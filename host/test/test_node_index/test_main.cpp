@@ -0,0 +1,159 @@
+// NodeNumIndex and sortMeshNodes: lookups through inserts and erases against a
+// reference map, sort order against upstream's bubble sort, and both timed at
+// MAX_NUM_NODES against what NodeDB did before
+
+#include "NodeNumIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <unity.h>
+#include <utility>
+
+static const NodeNum OUR_NUM = 0x1000;
+
+static meshtastic_NodeInfoLite nodes[MAX_NUM_NODES];
+static NodeNumIndex idx;
+
+void setUp(void)
+{
+    memset(nodes, 0, sizeof(nodes));
+    idx.clear();
+}
+
+void tearDown(void) {}
+
+static void test_find_matches_reference_through_churn(void)
+{
+    std::mt19937 rng(3);
+    std::map<NodeNum, uint16_t> reference;
+    for (int step = 0; step < 200000; step++) {
+        // Few distinct keys so probe chains collide and erase has to shift them
+        NodeNum num = rng() % (MAX_NUM_NODES * 2);
+        if (rng() % 2 && reference.size() < MAX_NUM_NODES) {
+            uint16_t pos = rng() % MAX_NUM_NODES;
+            idx.insert(num, pos);
+            reference[num] = pos;
+        } else {
+            idx.erase(num);
+            reference.erase(num);
+        }
+        TEST_ASSERT_EQUAL_size_t(reference.size(), idx.size());
+        if (step % 64 == 0) {
+            for (NodeNum n = 0; n < MAX_NUM_NODES * 2; n++) {
+                auto it = reference.find(n);
+                TEST_ASSERT_EQUAL_INT(it == reference.end() ? -1 : it->second, idx.find(n));
+            }
+        }
+    }
+}
+
+// NodeDB::sortMeshDB before sortMeshNodes
+static void bubbleSort(meshtastic_NodeInfoLite *db, int count, NodeNum ourNum)
+{
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = count - 1; i > 0; i--) {
+            if (db[i - 1].num == ourNum) {
+            } else if (db[i].num == ourNum) {
+                std::swap(db[i], db[i - 1]);
+                changed = true;
+            } else if (db[i].is_favorite && !db[i - 1].is_favorite) {
+                std::swap(db[i], db[i - 1]);
+                changed = true;
+            } else if (!db[i].is_favorite && db[i - 1].is_favorite) {
+            } else if (db[i].last_heard > db[i - 1].last_heard) {
+                std::swap(db[i], db[i - 1]);
+                changed = true;
+            }
+        }
+    }
+}
+
+// A full DB in arrival order: distinct last_heard so both sorts have one answer
+static void fillShuffled(uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    for (int i = 0; i < MAX_NUM_NODES; i++) {
+        nodes[i].num = i == 0 ? OUR_NUM : 0x20000 + rng() % 0x1000000;
+        nodes[i].last_heard = i * 7 + 1;
+        nodes[i].is_favorite = rng() % 10 == 0;
+        snprintf(nodes[i].user.long_name, sizeof(nodes[i].user.long_name), "Node %d", i);
+    }
+    std::shuffle(nodes, nodes + MAX_NUM_NODES, rng);
+}
+
+static void test_sort_matches_bubble_sort(void)
+{
+    static meshtastic_NodeInfoLite expected[MAX_NUM_NODES];
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        fillShuffled(seed);
+        memcpy(expected, nodes, sizeof(nodes));
+        bubbleSort(expected, MAX_NUM_NODES, OUR_NUM);
+        sortMeshNodes(nodes, MAX_NUM_NODES, OUR_NUM);
+        TEST_ASSERT_EQUAL_UINT32(OUR_NUM, nodes[0].num);
+        TEST_ASSERT_EQUAL_MEMORY(expected, nodes, sizeof(nodes));
+    }
+}
+
+template <typename F> static double nsPerCall(int calls, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        f(i);
+    }
+    auto took = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(took).count() / calls;
+}
+
+static void test_benchmark_lookup_and_sort(void)
+{
+    fillShuffled(42);
+    idx.rebuild(nodes, MAX_NUM_NODES);
+
+    // Mostly known senders, as on a busy mesh, and some strangers
+    std::mt19937 rng(9);
+    static NodeNum senders[4096];
+    for (NodeNum &num : senders) {
+        num = rng() % 8 ? nodes[rng() % MAX_NUM_NODES].num : rng();
+    }
+    volatile int sink = 0;
+    double indexNs = nsPerCall(1000000, [&](int i) { sink += idx.find(senders[i & 4095]); });
+    double scanNs = nsPerCall(1000000, [&](int i) {
+        NodeNum num = senders[i & 4095];
+        for (int j = 0; j < MAX_NUM_NODES; j++) {
+            if (nodes[j].num == num) {
+                sink += j;
+                break;
+            }
+        }
+    });
+
+    static meshtastic_NodeInfoLite shuffled[MAX_NUM_NODES];
+    memcpy(shuffled, nodes, sizeof(nodes));
+    double sortNs = nsPerCall(200, [&](int) {
+        memcpy(nodes, shuffled, sizeof(nodes));
+        sortMeshNodes(nodes, MAX_NUM_NODES, OUR_NUM);
+    });
+    double bubbleNs = nsPerCall(20, [&](int) {
+        memcpy(nodes, shuffled, sizeof(nodes));
+        bubbleSort(nodes, MAX_NUM_NODES, OUR_NUM);
+    });
+
+    char line[160];
+    snprintf(line, sizeof(line), "%d nodes: lookup %.1f ns indexed vs %.1f ns scanned; sort %.1f us vs %.1f us bubble",
+             MAX_NUM_NODES, indexNs, scanNs, sortNs / 1000, bubbleNs / 1000);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN(scanNs, indexNs);
+    TEST_ASSERT_LESS_THAN(bubbleNs, sortNs);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_find_matches_reference_through_churn);
+    RUN_TEST(test_sort_matches_bubble_sort);
+    RUN_TEST(test_benchmark_lookup_and_sort);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+// TelegramNodeTable: lookup and expiry against a reference model, and the cost of
+// tracking a packet at 50/500/5000 nodes next to the string-keyed array it replaced
+
+#include "TelegramNodeTable.h"
+#include <chrono>
+#include <map>
+#include <random>
+#include <unity.h>
+
+static const uint32_t TIMEOUT_MS = 3600000;
+
+static TelegramNodeTable table(TIMEOUT_MS); // Too large for the stack at 5000 nodes
+
+void setUp(void)
+{
+    hostSetMillis(0);
+    table = TelegramNodeTable(TIMEOUT_MS);
+}
+
+void tearDown(void) {}
+
+static void test_matches_reference_through_random_traffic(void)
+{
+    std::mt19937 rng(1);
+    std::map<NodeNum, uint32_t> seen;
+    uint32_t now = 0;
+    for (int step = 0; step < 200000; step++) {
+        now += rng() % 20000;
+        NodeNum num = rng() % 80 + 1;
+        if (table.touch(num, now)) {
+            seen[num] = now;
+        }
+        table.expire(now);
+
+        // Stale within one wheel tick of the timeout, never before it
+        for (auto it = seen.begin(); it != seen.end();) {
+            uint32_t age = now - it->second;
+            TrackedNode *node = table.find(it->first);
+            if (age <= TIMEOUT_MS) {
+                TEST_ASSERT_NOT_NULL(node);
+                TEST_ASSERT_EQUAL_UINT32(it->second, node->lastSeen);
+            } else if (age > TIMEOUT_MS + 2 * TELEGRAM_WHEEL_TICK_MS) {
+                TEST_ASSERT_NULL(node);
+            }
+            it = node ? std::next(it) : seen.erase(it);
+        }
+        TEST_ASSERT_EQUAL_size_t(seen.size(), table.size());
+    }
+    for (size_t i = 0; i < table.size(); i++) {
+        TEST_ASSERT_EQUAL_PTR(&table.at(i), table.find(table.at(i).num));
+    }
+}
+
+static void test_refuses_when_full(void)
+{
+    for (NodeNum num = 1; num <= TELEGRAM_NODE_CAPACITY; num++) {
+        TEST_ASSERT_NOT_NULL(table.touch(num, 0));
+    }
+    TEST_ASSERT_NULL(table.touch(TELEGRAM_NODE_CAPACITY + 1, 0));
+    TEST_ASSERT_NOT_NULL(table.touch(1, 1000));
+    TEST_ASSERT_EQUAL_size_t(TELEGRAM_NODE_CAPACITY, table.expire(TIMEOUT_MS + 2 * TELEGRAM_WHEEL_TICK_MS));
+}
+
+// What updateNodeSeen and clearStaleNodes did before: "!%08x" ids, strcmp over
+// every tracked node per packet, and a full compaction once a second
+struct StringNode {
+    char nodeId[16];
+    char nodeName[40];
+    uint32_t lastSeen;
+};
+
+static StringNode stringNodes[TELEGRAM_NODE_CAPACITY];
+static int stringCount;
+
+static void stringSeen(NodeNum num, uint32_t now)
+{
+    char id[16];
+    snprintf(id, sizeof(id), "!%08x", (unsigned)num);
+    for (int i = 0; i < stringCount; i++) {
+        if (strcmp(stringNodes[i].nodeId, id) == 0) {
+            stringNodes[i].lastSeen = now;
+            return;
+        }
+    }
+    if (stringCount < TELEGRAM_NODE_CAPACITY) {
+        strcpy(stringNodes[stringCount].nodeId, id);
+        stringNodes[stringCount++].lastSeen = now;
+    }
+}
+
+static void stringClearStale(uint32_t now)
+{
+    int kept = 0;
+    for (int i = 0; i < stringCount; i++) {
+        if (now - stringNodes[i].lastSeen < TIMEOUT_MS) {
+            stringNodes[kept++] = stringNodes[i];
+        }
+    }
+    stringCount = kept;
+}
+
+// ns per packet over a second of traffic at 100 packets/s, including that
+// second's expiry pass
+template <typename Seen, typename Expire> static double nsPerPacket(size_t nodes, Seen seen, Expire expire)
+{
+    std::mt19937 rng(7);
+    const int rounds = 50;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        uint32_t now = 1000 * (round + 1);
+        for (int packet = 0; packet < 100; packet++) {
+            seen(0x10000 + rng() % nodes, now);
+        }
+        expire(now);
+    }
+    auto took = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(took).count() / (rounds * 100);
+}
+
+static void test_benchmark_packet_cost(void)
+{
+    for (size_t nodes : {(size_t)50, (size_t)500, (size_t)5000}) {
+        table = TelegramNodeTable(TIMEOUT_MS);
+        stringCount = 0;
+        for (size_t i = 0; i < nodes; i++) {
+            table.touch(0x10000 + i, 0);
+            stringSeen(0x10000 + i, 0);
+        }
+
+        double tableNs = nsPerPacket(
+            nodes, [](NodeNum num, uint32_t now) { table.touch(num, now); },
+            [](uint32_t now) { table.expire(now); });
+        double stringNs = nsPerPacket(nodes, stringSeen, stringClearStale);
+
+        char line[128];
+        snprintf(line, sizeof(line), "%4u nodes: %7.1f ns/packet NodeNum table, %9.1f ns/packet string array",
+                 (unsigned)nodes, tableNs, stringNs);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_EQUAL_size_t(nodes, table.size());
+        if (nodes >= 500) {
+            TEST_ASSERT_LESS_THAN(stringNs, tableNs);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_reference_through_random_traffic);
+    RUN_TEST(test_refuses_when_full);
+    RUN_TEST(test_benchmark_packet_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,301 @@
+// NodeDBJournal: what a reboot replays after saves, after changes made without
+// markDirty(), after a power cut mid-record, and on top of the wrong snapshot;
+// plus bytes and time per save against rewriting the whole snapshot
+
+#include "FSCommon.h"
+#include "NodeDBJournal.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <unity.h>
+#include <vector>
+
+static const char *SNAPSHOT = "/prefs/nodes.proto";
+static const char *JOURNAL = "/prefs/nodes.jrnl";
+
+// Enough of NodeDB to drive the journal the way it does: the snapshot is the raw
+// node array, saves go through markChanged() and compact when the journal says so
+struct NodeDBModel {
+    std::vector<meshtastic_NodeInfoLite> nodes;
+    std::unique_ptr<NodeDBJournal> journal{new NodeDBJournal()};
+    uint32_t snapshotBytes = 0;
+
+    meshtastic_NodeInfoLite *find(NodeNum num)
+    {
+        for (auto &node : nodes) {
+            if (node.num == num) {
+                return &node;
+            }
+        }
+        return nullptr;
+    }
+
+    void add(NodeNum num, uint32_t heard)
+    {
+        meshtastic_NodeInfoLite node = {};
+        node.num = num;
+        node.last_heard = heard;
+        snprintf(node.user.long_name, sizeof(node.user.long_name), "Node %08x", (unsigned)num);
+        nodes.push_back(node);
+        journal->markDirty(num);
+    }
+
+    void remove(NodeNum num)
+    {
+        nodes.erase(std::find_if(nodes.begin(), nodes.end(), [num](const meshtastic_NodeInfoLite &n) { return n.num == num; }));
+        journal->markDirty(num);
+    }
+
+    bool save()
+    {
+        journal->markChanged(nodes.data(), nodes.size(), lookup);
+        if (!journal->needsCompaction()) {
+            return journal->flush(lookup);
+        }
+        std::vector<uint8_t> &file = hostFiles[SNAPSHOT];
+        file.assign((const uint8_t *)nodes.data(), (const uint8_t *)(nodes.data() + nodes.size()));
+        snapshotBytes += file.size();
+        journal->reset(SNAPSHOT);
+        journal->remember(nodes.data(), nodes.size());
+        return true;
+    }
+
+    /// What loadFromDisk does after a restart; returns the records replayed
+    int reboot()
+    {
+        journal.reset(new NodeDBJournal());
+        const std::vector<uint8_t> &file = hostFiles[SNAPSHOT];
+        nodes.resize(file.size() / sizeof(meshtastic_NodeInfoLite));
+        memcpy(nodes.data(), file.data(), file.size());
+
+        int replayed = -1;
+        if (journal->beginReplay(SNAPSHOT)) {
+            meshtastic_NodeInfoLite record;
+            NodeDBJournal::RecordType type;
+            replayed = 0;
+            while ((type = journal->nextRecord(record)) != NodeDBJournal::END) {
+                meshtastic_NodeInfoLite *node = find(record.num);
+                if (type == NodeDBJournal::UPSERT) {
+                    if (node) {
+                        *node = record;
+                    } else {
+                        nodes.push_back(record);
+                    }
+                } else if (node) {
+                    *node = nodes.back();
+                    nodes.pop_back();
+                }
+                replayed++;
+            }
+            journal->endReplay();
+        }
+        journal->remember(nodes.data(), nodes.size());
+        return replayed;
+    }
+
+    static const meshtastic_NodeInfoLite *lookup(NodeNum num) { return current->find(num); }
+    static NodeDBModel *current;
+};
+
+NodeDBModel *NodeDBModel::current;
+
+static std::unique_ptr<NodeDBModel> db;
+
+void setUp(void)
+{
+    hostFiles.clear();
+    hostWriteBudget = -1;
+    db.reset(new NodeDBModel());
+    NodeDBModel::current = db.get();
+}
+
+void tearDown(void)
+{
+    db.reset();
+}
+
+static std::vector<meshtastic_NodeInfoLite> sortedNodes()
+{
+    std::vector<meshtastic_NodeInfoLite> nodes = db->nodes;
+    std::sort(nodes.begin(), nodes.end(), [](const meshtastic_NodeInfoLite &a, const meshtastic_NodeInfoLite &b) {
+        return a.num < b.num;
+    });
+    return nodes;
+}
+
+static void assertSameNodes(const std::vector<meshtastic_NodeInfoLite> &expected)
+{
+    std::vector<meshtastic_NodeInfoLite> actual = sortedNodes();
+    TEST_ASSERT_EQUAL_size_t(expected.size(), actual.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), actual.data(), expected.size() * sizeof(meshtastic_NodeInfoLite));
+}
+
+static void fill(size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        db->add(0x1000 + i, i);
+    }
+    TEST_ASSERT_TRUE(db->save());
+}
+
+static void test_reboot_replays_every_saved_change(void)
+{
+    fill(50);
+    std::mt19937 rng(5);
+    for (int round = 0; round < 40; round++) {
+        for (int change = 0; change < 3; change++) {
+            meshtastic_NodeInfoLite &node = db->nodes[rng() % db->nodes.size()];
+            node.last_heard = 1000 + round;
+            node.snr = round / 4.0f;
+            db->journal->markDirty(node.num);
+        }
+        if (round % 5 == 0) {
+            db->remove(db->nodes[rng() % db->nodes.size()].num);
+            db->add(0x9000 + round, round);
+        }
+        TEST_ASSERT_TRUE(db->save());
+    }
+    // The journal outgrew NODEDB_JOURNAL_MAX_BYTES and was compacted along the way
+    TEST_ASSERT_GREATER_THAN_UINT32(1, db->journal->stats().compactions);
+
+    std::vector<meshtastic_NodeInfoLite> expected = sortedNodes();
+    TEST_ASSERT_GREATER_OR_EQUAL(0, db->reboot());
+    assertSameNodes(expected);
+    TEST_ASSERT_FALSE(db->journal->needsCompaction());
+}
+
+static void test_changes_without_mark_dirty_are_saved(void)
+{
+    fill(20);
+    // As AdminModule's set_ignored_node does: change in place, then save
+    db->nodes[3].is_ignored = true;
+    db->nodes[7].bitfield |= NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK;
+    // And a node dropped without telling the journal
+    NodeNum gone = db->nodes[11].num;
+    db->nodes.erase(db->nodes.begin() + 11);
+    TEST_ASSERT_TRUE(db->save());
+    TEST_ASSERT_EQUAL_UINT32(3, db->journal->stats().records);
+
+    std::vector<meshtastic_NodeInfoLite> expected = sortedNodes();
+    TEST_ASSERT_EQUAL_INT(3, db->reboot());
+    assertSameNodes(expected);
+    TEST_ASSERT_NULL(db->find(gone));
+
+    // Nothing changed, nothing written
+    TEST_ASSERT_TRUE(db->save());
+    TEST_ASSERT_EQUAL_UINT32(0, db->journal->stats().records);
+}
+
+static void test_power_cut_mid_record_keeps_what_came_before(void)
+{
+    fill(10);
+    db->nodes[0].last_heard = 100;
+    db->journal->markDirty(db->nodes[0].num);
+    TEST_ASSERT_TRUE(db->save());
+    std::vector<meshtastic_NodeInfoLite> beforeCut = sortedNodes();
+
+    // The power goes while the second of two records is being written
+    size_t journalBytes = hostFiles[JOURNAL].size();
+    db->nodes[1].last_heard = 200;
+    db->nodes[2].last_heard = 300;
+    db->journal->markDirty(db->nodes[1].num);
+    db->journal->markDirty(db->nodes[2].num);
+    hostWriteBudget = (journalBytes - 8) + 20; // All of one record and part of the next
+    TEST_ASSERT_FALSE(db->save());
+    TEST_ASSERT_GREATER_THAN(journalBytes, hostFiles[JOURNAL].size());
+    hostWriteBudget = -1;
+
+    TEST_ASSERT_EQUAL_INT(2, db->reboot());
+    std::vector<meshtastic_NodeInfoLite> expected = beforeCut;
+    for (auto &node : expected) {
+        if (node.num == 0x1001) {
+            node.last_heard = 200;
+        }
+    }
+    assertSameNodes(expected);
+    // Nothing may be appended after the torn record, so the next save compacts
+    TEST_ASSERT_TRUE(db->journal->needsCompaction());
+    TEST_ASSERT_TRUE(db->save());
+    TEST_ASSERT_EQUAL_INT(0, db->reboot());
+    assertSameNodes(expected);
+}
+
+static void test_corrupt_record_stops_replay(void)
+{
+    fill(10);
+    for (int i = 0; i < 3; i++) {
+        db->nodes[i].last_heard = 100 + i;
+        db->journal->markDirty(db->nodes[i].num);
+        TEST_ASSERT_TRUE(db->save());
+    }
+    // Flip a byte in the second record's payload
+    std::vector<uint8_t> &journal = hostFiles[JOURNAL];
+    size_t record = (journal.size() - 8) / 3;
+    journal[8 + record + 10] ^= 0xFF;
+
+    TEST_ASSERT_EQUAL_INT(1, db->reboot());
+    TEST_ASSERT_EQUAL_UINT32(100, db->find(0x1000)->last_heard);
+    TEST_ASSERT_EQUAL_UINT32(1, db->find(0x1001)->last_heard);
+    TEST_ASSERT_TRUE(db->journal->needsCompaction());
+}
+
+static void test_journal_for_another_snapshot_is_ignored(void)
+{
+    fill(10);
+    db->nodes[0].last_heard = 100;
+    db->journal->markDirty(db->nodes[0].num);
+    TEST_ASSERT_TRUE(db->save());
+
+    // Power cut after a new snapshot was written but before the journal restarted
+    db->nodes[1].last_heard = 200;
+    std::vector<uint8_t> &file = hostFiles[SNAPSHOT];
+    file.assign((const uint8_t *)db->nodes.data(), (const uint8_t *)(db->nodes.data() + db->nodes.size()));
+    std::vector<meshtastic_NodeInfoLite> expected = sortedNodes();
+
+    TEST_ASSERT_EQUAL_INT(-1, db->reboot());
+    assertSameNodes(expected);
+    TEST_ASSERT_TRUE(db->journal->needsCompaction());
+}
+
+static void test_benchmark_save_cost(void)
+{
+    fill(MAX_NUM_NODES);
+    for (size_t changed : {(size_t)1, (size_t)10, (size_t)MAX_NUM_NODES / 4}) {
+        db->snapshotBytes = 0;
+        const NodeDBJournal::Stats before = db->journal->stats();
+        const int saves = 200;
+        auto start = std::chrono::steady_clock::now();
+        for (int save = 0; save < saves; save++) {
+            for (size_t i = 0; i < changed; i++) {
+                meshtastic_NodeInfoLite &node = db->nodes[(save * changed + i) % db->nodes.size()];
+                node.last_heard++;
+                db->journal->markDirty(node.num);
+            }
+            TEST_ASSERT_TRUE(db->save());
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        const NodeDBJournal::Stats &after = db->journal->stats();
+        uint32_t bytes = after.bytes - before.bytes + db->snapshotBytes;
+
+        char line[160];
+        snprintf(line, sizeof(line),
+                 "%3u of %d nodes changed: %6u bytes/save journaled (%u compactions) vs %u rewriting, %.1f us/save",
+                 (unsigned)changed, MAX_NUM_NODES, bytes / saves, after.compactions - before.compactions,
+                 (unsigned)(MAX_NUM_NODES * sizeof(meshtastic_NodeInfoLite)), us / saves);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_LESS_THAN(MAX_NUM_NODES * sizeof(meshtastic_NodeInfoLite), bytes / saves);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reboot_replays_every_saved_change);
+    RUN_TEST(test_changes_without_mark_dirty_are_saved);
+    RUN_TEST(test_power_cut_mid_record_keeps_what_came_before);
+    RUN_TEST(test_corrupt_record_stops_replay);
+    RUN_TEST(test_journal_for_another_snapshot_is_ignored);
+    RUN_TEST(test_benchmark_save_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,185 @@
+// TelegramOutbox: ordering, retry backoff, overflow policy, truncation, and
+// the receive path staying flat while a stub bot is slow to send
+
+#include "TelegramOutbox.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unity.h>
+#include <vector>
+
+static const char EURO[] = "\xE2\x82\xAC"; // Three bytes in UTF-8
+
+void setUp(void)
+{
+    hostSetMillis(1000);
+}
+
+void tearDown(void) {}
+
+static void pushText(TelegramOutbox &outbox, const char *text)
+{
+    TEST_ASSERT_TRUE(outbox.push(text, strlen(text), 0));
+}
+
+static void test_keeps_order_through_retries(void)
+{
+    TelegramOutbox outbox;
+    pushText(outbox, "one");
+    pushText(outbox, "two");
+
+    // A failed front stays in front and is held back with a doubling delay
+    TEST_ASSERT_FALSE(outbox.failFront(millis()));
+    TEST_ASSERT_NULL(outbox.peekReady(millis() + TELEGRAM_OUTBOX_RETRY_BASE_MS - 1));
+    OutboxItem *item = outbox.peekReady(millis() + TELEGRAM_OUTBOX_RETRY_BASE_MS);
+    TEST_ASSERT_NOT_NULL(item);
+    TEST_ASSERT_EQUAL_STRING("one", item->text);
+    TEST_ASSERT_FALSE(outbox.failFront(millis()));
+    TEST_ASSERT_NULL(outbox.peekReady(millis() + 2 * TELEGRAM_OUTBOX_RETRY_BASE_MS - 1));
+
+    outbox.completeFront();
+    item = outbox.peekReady(millis());
+    TEST_ASSERT_NOT_NULL(item);
+    TEST_ASSERT_EQUAL_STRING("two", item->text);
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.stats().retried);
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.stats().sent);
+}
+
+static void test_drops_after_max_attempts(void)
+{
+    TelegramOutbox outbox;
+    pushText(outbox, "doomed");
+    for (int i = 1; i < TELEGRAM_OUTBOX_MAX_ATTEMPTS; i++) {
+        TEST_ASSERT_FALSE(outbox.failFront(millis()));
+    }
+    TEST_ASSERT_TRUE(outbox.failFront(millis()));
+    TEST_ASSERT_TRUE(outbox.isEmpty());
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.stats().droppedRetries);
+}
+
+static void test_retry_timing_survives_millis_wraparound(void)
+{
+    TelegramOutbox outbox;
+    pushText(outbox, "late");
+    uint32_t now = UINT32_MAX - 100;
+    outbox.failFront(now);
+    TEST_ASSERT_NULL(outbox.peekReady(now + 1000));
+    TEST_ASSERT_NOT_NULL(outbox.peekReady(now + TELEGRAM_OUTBOX_RETRY_BASE_MS));
+}
+
+static void test_overflow_policies(void)
+{
+    char text[12];
+    TelegramOutbox oldest(OutboxOverflowPolicy::DROP_OLDEST);
+    TelegramOutbox newest(OutboxOverflowPolicy::DROP_NEWEST);
+    for (int i = 0; i <= TELEGRAM_OUTBOX_DEPTH; i++) {
+        snprintf(text, sizeof(text), "%d", i);
+        TEST_ASSERT_TRUE(oldest.push(text, strlen(text), 0));
+        TEST_ASSERT_EQUAL(i < TELEGRAM_OUTBOX_DEPTH, newest.push(text, strlen(text), 0));
+    }
+    TEST_ASSERT_EQUAL_STRING("1", oldest.peekAt(0)->text);
+    TEST_ASSERT_EQUAL_STRING("0", newest.peekAt(0)->text);
+    TEST_ASSERT_EQUAL_UINT32(1, oldest.stats().droppedOverflow);
+    TEST_ASSERT_EQUAL_UINT32(1, newest.stats().droppedOverflow);
+    TEST_ASSERT_EQUAL_UINT16(TELEGRAM_OUTBOX_DEPTH, oldest.stats().highWater);
+}
+
+static void test_truncates_on_a_character_boundary(void)
+{
+    // A multi-byte character straddling the limit goes as a whole
+    char text[TELEGRAM_OUTBOX_TEXT_MAX + 8];
+    size_t lead = TELEGRAM_OUTBOX_TEXT_MAX - 2;
+    memset(text, 'a', lead);
+    memcpy(text + lead, EURO, 3);
+    memset(text + lead + 3, 'b', sizeof(text) - lead - 3);
+
+    TelegramOutbox outbox;
+    TEST_ASSERT_TRUE(outbox.push(text, sizeof(text), 0));
+    OutboxItem *item = outbox.peekAt(0);
+    TEST_ASSERT_EQUAL_UINT16(lead, item->length);
+    TEST_ASSERT_EQUAL_size_t(lead, strlen(item->text));
+
+    // One that ends exactly at the limit is kept
+    memset(text, 'a', sizeof(text));
+    memcpy(text + TELEGRAM_OUTBOX_TEXT_MAX - 4, EURO, 3);
+    TEST_ASSERT_TRUE(outbox.push(text, sizeof(text), 0));
+    TEST_ASSERT_EQUAL_UINT16(TELEGRAM_OUTBOX_TEXT_MAX - 1, outbox.peekAt(1)->length);
+}
+
+// The sender side: a bot whose every sendMessage takes sendMs of real time
+struct SlowBot {
+    uint32_t sendMs;
+    std::vector<std::string> delivered;
+
+    void send(const OutboxItem &item)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(sendMs));
+        delivered.push_back(item.text);
+    }
+};
+
+static uint32_t percentile(std::vector<uint32_t> samples, int percent)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) * percent / 100];
+}
+
+// Receive-path latency in ns (one push per packet) with a drain pass after every
+// few packets, the way runOnce interleaves with the Router
+static uint32_t receivePathP99(uint32_t sendMs, size_t packets, std::vector<std::string> &delivered)
+{
+    TelegramOutbox outbox;
+    SlowBot bot = {sendMs, {}};
+    std::vector<uint32_t> pushNs;
+    char text[64];
+    for (size_t i = 0; i < packets; i++) {
+        int len = snprintf(text, sizeof(text), "packet %u", (unsigned)i);
+        auto start = std::chrono::steady_clock::now();
+        outbox.push(text, len, 0);
+        auto took = std::chrono::steady_clock::now() - start;
+        pushNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+
+        for (int sends = 0; sends < 2; sends++) {
+            OutboxItem *item = outbox.peekReady(millis());
+            if (!item) {
+                break;
+            }
+            bot.send(*item);
+            outbox.completeFront();
+        }
+    }
+    delivered = bot.delivered;
+    return percentile(pushNs, 99);
+}
+
+static void test_receive_path_stays_flat_while_sends_are_slow(void)
+{
+    const size_t packets = 100;
+    std::vector<std::string> fast, slow;
+    uint32_t fastP99 = receivePathP99(0, packets, fast);
+    uint32_t slowP99 = receivePathP99(5, packets, slow);
+
+    char line[128];
+    snprintf(line, sizeof(line), "receive path p99: %u ns with instant sends, %u ns with 5 ms sends", fastP99,
+             slowP99);
+    TEST_MESSAGE(line);
+
+    // Sending inline would have cost the receive path the whole 5 ms every time
+    TEST_ASSERT_LESS_THAN_UINT32(1000000, slowP99);
+    TEST_ASSERT_EQUAL_size_t(packets, slow.size());
+    for (size_t i = 0; i < packets; i++) {
+        TEST_ASSERT_EQUAL_STRING(fast[i].c_str(), slow[i].c_str());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_keeps_order_through_retries);
+    RUN_TEST(test_drops_after_max_attempts);
+    RUN_TEST(test_retry_timing_survives_millis_wraparound);
+    RUN_TEST(test_overflow_policies);
+    RUN_TEST(test_truncates_on_a_character_boundary);
+    RUN_TEST(test_receive_path_stays_flat_while_sends_are_slow);
+    return UNITY_END();
+}
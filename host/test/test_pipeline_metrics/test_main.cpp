@@ -0,0 +1,124 @@
+// PipelineMetrics: histogram buckets and percentiles, the arrival FIFO alongside fromRadioQueue,
+// and the cost of one stage probe
+
+#include "PipelineMetrics.h"
+#include <chrono>
+#include <unity.h>
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_bucket_edges(void)
+{
+    LatencyHistogram h = {};
+    h.record(0);
+    h.record(15);
+    h.record(16);
+    h.record(31);
+    h.record(32);
+    h.record(UINT32_MAX);
+    TEST_ASSERT_EQUAL_UINT32(2, h.buckets[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, h.buckets[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.buckets[2]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.buckets[LATENCY_BUCKETS - 1]);
+    TEST_ASSERT_EQUAL_UINT32(6, h.count);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, h.maxUs);
+}
+
+static void test_percentiles_are_bucket_upper_bounds(void)
+{
+    LatencyHistogram h = {};
+    TEST_ASSERT_EQUAL_UINT32(0, h.percentileUs(50));
+
+    // 1 ms to 1 s evenly: the true p50 is 500 ms, in [262144, 524288) us
+    for (uint32_t ms = 1; ms <= 1000; ms++) {
+        h.record(ms * 1000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(524288, h.percentileUs(50));
+    TEST_ASSERT_EQUAL_UINT32(1000000, h.percentileUs(95)); // Capped at the largest value seen
+    TEST_ASSERT_EQUAL_UINT32(1000000, h.percentileUs(100));
+    TEST_ASSERT_EQUAL_UINT32(16384, h.percentileUs(1)); // The 10th value, 10 ms
+
+    // Never below the true value
+    LatencyHistogram one = {};
+    one.record(700);
+    TEST_ASSERT_EQUAL_UINT32(700, one.percentileUs(99));
+}
+
+static void test_arrivals_follow_the_queue(void)
+{
+    PipelineMetrics m;
+    m.packetQueued(100);
+    m.packetQueued(200);
+    m.packetQueued(300);
+    m.packetDropped(); // fromRadioQueue discards its oldest
+    TEST_ASSERT_EQUAL_UINT8(3, m.queueHighWater());
+    TEST_ASSERT_EQUAL_UINT32(1, m.counter(PipelineCounter::RX_DROPPED));
+    TEST_ASSERT_EQUAL_UINT32(3, m.counter(PipelineCounter::RX_PACKETS));
+
+    m.packetDequeued(1000);
+    TEST_ASSERT_EQUAL_UINT32(200, m.arrivalOfCurrent());
+    m.packetDequeued(1500);
+    TEST_ASSERT_EQUAL_UINT32(300, m.arrivalOfCurrent());
+    TEST_ASSERT_EQUAL_UINT32(2, m.histogram(PipelineStage::RX_QUEUE).count);
+    TEST_ASSERT_EQUAL_UINT32(1200, m.histogram(PipelineStage::RX_QUEUE).maxUs);
+
+    // A packet handled without a stamp is timed from its dequeue
+    m.packetDequeued(2000);
+    TEST_ASSERT_EQUAL_UINT32(2000, m.arrivalOfCurrent());
+    TEST_ASSERT_EQUAL_UINT32(2, m.histogram(PipelineStage::RX_QUEUE).count);
+
+    // Wraparound of micros() still gives the right wait
+    m.packetQueued(UINT32_MAX - 50);
+    m.packetDequeued(50);
+    TEST_ASSERT_EQUAL_UINT32(1200, m.histogram(PipelineStage::RX_QUEUE).maxUs);
+    TEST_ASSERT_EQUAL_UINT32(3, m.histogram(PipelineStage::RX_QUEUE).count);
+}
+
+static uint32_t steadyMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void test_probe_cost(void)
+{
+    // What each stage probe does: read the clock, read it again, record the difference. The host
+    // clock stands still, so this times a real one.
+    const uint32_t runs = 1000000;
+    PipelineMetrics m;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; i++) {
+        uint32_t t = steadyMicros();
+        m.record(PipelineStage::DECODE, steadyMicros() - t);
+    }
+    auto probe = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; i++) {
+        m.record(PipelineStage::MODULES, i & 0xffff);
+    }
+    auto record = std::chrono::steady_clock::now() - start;
+
+    double probeNs = std::chrono::duration<double, std::nano>(probe).count() / runs;
+    double recordNs = std::chrono::duration<double, std::nano>(record).count() / runs;
+    char line[160];
+    snprintf(line, sizeof(line), "probe %.1f ns (histogram update alone %.1f ns), %u bytes of metrics", probeNs,
+             recordNs, (unsigned)sizeof(PipelineMetrics));
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(runs, m.histogram(PipelineStage::DECODE).count);
+    TEST_ASSERT_TRUE(probeNs < 1000);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_edges);
+    RUN_TEST(test_percentiles_are_bucket_upper_bounds);
+    RUN_TEST(test_arrivals_follow_the_queue);
+    RUN_TEST(test_probe_cost);
+    return UNITY_END();
+}
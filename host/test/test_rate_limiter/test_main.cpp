@@ -0,0 +1,163 @@
+// TelegramRateLimiter: burst, sustained rate with no rounding loss, retry_after;
+// outbox batching at a steady 2 packets/s staying under the limit without loss
+
+#include "TelegramOutbox.h"
+#include "TelegramRateLimiter.h"
+#include <string>
+#include <unity.h>
+#include <vector>
+
+// Mirrors TelegramModule.h / .cpp
+static const size_t MESSAGE_LIMIT = 4096;
+static const uint32_t BATCH_WINDOW_MS = 3000;
+
+void setUp(void)
+{
+    hostSetMillis(0);
+}
+
+void tearDown(void) {}
+
+static uint32_t sendsOver(TelegramRateLimiter &limiter, uint32_t from, uint32_t to, uint32_t step)
+{
+    uint32_t sent = 0;
+    for (uint32_t now = from; now <= to; now += step) {
+        if (limiter.tryAcquire(now)) {
+            sent++;
+        }
+    }
+    return sent;
+}
+
+static void test_burst_then_sustained_rate(void)
+{
+    TelegramRateLimiter limiter(20, 3);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(limiter.tryAcquire(0));
+    }
+    TEST_ASSERT_FALSE(limiter.tryAcquire(0));
+    TEST_ASSERT_EQUAL_UINT32(3000, limiter.msUntilReady(0));
+    TEST_ASSERT_GREATER_THAN_UINT32(0, limiter.msUntilReady(2999));
+    TEST_ASSERT_TRUE(limiter.tryAcquire(3000));
+    TEST_ASSERT_EQUAL_UINT32(1, limiter.throttledCount());
+}
+
+static void test_frequent_polls_lose_no_rate(void)
+{
+    // Polling every few ms used to round a little of each refill away. The 200th refill
+    // lands at exactly 10 minutes; the extra second lets every step size reach it.
+    for (uint32_t step : {1u, 7u, 50u, 333u}) {
+        TelegramRateLimiter limiter(20, 3);
+        TEST_ASSERT_EQUAL_UINT32(3 + 200, sendsOver(limiter, 0, 601000, step));
+    }
+    // 8571.4 ms per token doesn't divide evenly
+    TelegramRateLimiter odd(7, 1);
+    TEST_ASSERT_EQUAL_UINT32(1 + 700, sendsOver(odd, 0, 6000000, 3));
+}
+
+static void test_retry_after_pauses_then_resumes_at_rate(void)
+{
+    TelegramRateLimiter limiter(20, 3);
+    limiter.pauseFor(1000, 30);
+    TEST_ASSERT_EQUAL_UINT32(30000, limiter.msUntilReady(1000));
+    TEST_ASSERT_FALSE(limiter.tryAcquire(30999));
+    // The bucket starts empty after the pause, so there's no burst straight away
+    TEST_ASSERT_FALSE(limiter.tryAcquire(31000));
+    TEST_ASSERT_TRUE(limiter.tryAcquire(34000));
+    TEST_ASSERT_FALSE(limiter.tryAcquire(34000));
+}
+
+static void test_idle_refill_is_capped_at_burst(void)
+{
+    TelegramRateLimiter limiter(20, 3);
+    sendsOver(limiter, 0, 0, 1);
+    TEST_ASSERT_EQUAL_UINT32(3, sendsOver(limiter, 3600000, 3600000 + 10, 1));
+}
+
+static void test_batch_count_fits_the_limit(void)
+{
+    TelegramOutbox outbox;
+    char text[TELEGRAM_OUTBOX_TEXT_MAX];
+    memset(text, 'x', sizeof(text));
+    for (int i = 0; i < TELEGRAM_OUTBOX_DEPTH; i++) {
+        outbox.push(text, 100, 0);
+    }
+    // 100 + 2 + 100 + 2 + 100 = 304
+    TEST_ASSERT_EQUAL_size_t(2, outbox.batchCount(303));
+    TEST_ASSERT_EQUAL_size_t(3, outbox.batchCount(304));
+    TEST_ASSERT_EQUAL_size_t(TELEGRAM_OUTBOX_DEPTH, outbox.batchCount(MESSAGE_LIMIT));
+    // A front message longer than the limit still goes on its own
+    TEST_ASSERT_EQUAL_size_t(1, outbox.batchCount(50));
+}
+
+// Steady mesh traffic drained the way TelegramModule::flushOutbox does: hold a batch
+// open for the window, then send it when the limiter allows
+static void test_steady_traffic_batches_under_the_limit(void)
+{
+    const uint32_t minutes = 10;
+    const uint32_t packetEveryMs = 500;
+    TelegramOutbox outbox;
+    TelegramRateLimiter limiter(20, 3);
+    std::vector<std::string> delivered;
+    std::vector<uint32_t> perMinute(minutes, 0);
+    uint32_t produced = 0;
+    uint32_t requests = 0;
+    char text[64];
+
+    for (uint32_t now = 0; now < minutes * 60000; now += 10) {
+        hostSetMillis(now);
+        if (now % packetEveryMs == 0) {
+            int len = snprintf(text, sizeof(text), "[Node %u] hello from the mesh", (unsigned)produced++);
+            TEST_ASSERT_TRUE(outbox.push(text, len, 0));
+        }
+
+        OutboxItem *first = outbox.peekReady(now);
+        if (!first) {
+            continue;
+        }
+        size_t count = outbox.batchCount(MESSAGE_LIMIT);
+        bool batchFull = count < outbox.size() || outbox.isFull();
+        if (!batchFull && now - first->enqueuedAt < BATCH_WINDOW_MS) {
+            continue;
+        }
+        if (!limiter.tryAcquire(now)) {
+            continue;
+        }
+        for (size_t i = 0; i < count; i++) {
+            delivered.push_back(outbox.peekAt(i)->text);
+        }
+        outbox.completeFront(count);
+        perMinute[now / 60000]++;
+        requests++;
+    }
+
+    uint32_t busiest = 0;
+    for (uint32_t minute : perMinute) {
+        busiest = max(busiest, minute);
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "%u packets in %u requests, busiest minute %u requests",
+             (unsigned)produced, (unsigned)requests, (unsigned)busiest);
+    TEST_MESSAGE(line);
+
+    // One request per packet would be 120 a minute and trip Telegram's 429s
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(20 + 3, busiest);
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.stats().droppedOverflow);
+    TEST_ASSERT_EQUAL_size_t(produced - outbox.size(), delivered.size());
+    for (size_t i = 0; i < delivered.size(); i++) {
+        snprintf(text, sizeof(text), "[Node %u] hello from the mesh", (unsigned)i);
+        TEST_ASSERT_EQUAL_STRING(text, delivered[i].c_str());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_then_sustained_rate);
+    RUN_TEST(test_frequent_polls_lose_no_rate);
+    RUN_TEST(test_retry_after_pauses_then_resumes_at_rate);
+    RUN_TEST(test_idle_refill_is_capped_at_burst);
+    RUN_TEST(test_batch_count_fits_the_limit);
+    RUN_TEST(test_steady_traffic_batches_under_the_limit);
+    return UNITY_END();
+}
@@ -0,0 +1,241 @@
+// TelegramReplyCache behind the node table's generations: repeated commands rendered once, each
+// kind of node change invalidating exactly the replies that show it, age caps, replies too big
+// for their slot; a render against a hit for a full /nodes reply
+//
+// Gateway below mirrors TelegramModule::runCommand and replyGeneration, with renders that count
+// how often they run instead of formatting the real replies (except /nodes, for the timing).
+
+#include "TelegramNodeTable.h"
+#include "TelegramReplyCache.h"
+#include <chrono>
+#include <unity.h>
+
+#define TIMEOUT_MS 3600000
+#define NODES_CACHE_MS 30000 // As in TelegramModule.h
+#define STATUS_CACHE_MS 5000
+#define CONFIG_CACHE_MS 60000
+
+static const CachedReply REPLIES[] = {CachedReply::NODES, CachedReply::MAP, CachedReply::STATUS,
+                                      CachedReply::CONFIG};
+
+struct Gateway {
+    TelegramNodeTable table{TIMEOUT_MS};
+    TelegramReplyCache cache;
+    TelegramTextBuffer<4097> render;
+    uint32_t renders[(size_t)CachedReply::COUNT] = {};
+    uint32_t now = 0;
+
+    uint32_t generation(CachedReply reply) const
+    {
+        switch (reply) {
+        case CachedReply::NODES:
+        case CachedReply::STATUS:
+            return table.generation();
+        case CachedReply::MAP:
+            return table.locationGeneration();
+        default:
+            return 0; // /config: a new configuration only applies after a restart
+        }
+    }
+
+    static uint32_t maxAge(CachedReply reply)
+    {
+        switch (reply) {
+        case CachedReply::NODES:
+            return NODES_CACHE_MS;
+        case CachedReply::STATUS:
+            return STATUS_CACHE_MS;
+        case CachedReply::CONFIG:
+            return CONFIG_CACHE_MS;
+        default:
+            return 0;
+        }
+    }
+
+    void renderNodes()
+    {
+        render.addf("Found *%d* active nodes:\n\n", (int)table.size());
+        for (size_t i = 0; i < table.size() && !render.truncated(); i++) {
+            const TrackedNode &node = table.at(i);
+            char id[12];
+            snprintf(id, sizeof(id), "!%08x", node.num);
+            render.add("• *").addEscaped(node.name[0] ? node.name : id).add("*\n");
+            render.addf("  ID: `%s`\n", id);
+            if (node.hasLocation) {
+                render.add("  📍 GPS: ").addDegrees(node.latitudeI).add(", ").addDegrees(node.longitudeI).add("\n");
+            }
+            render.add("  Last seen: ").addTimeAgo(now - node.lastSeen).add("\n\n");
+        }
+    }
+
+    const char *run(CachedReply reply)
+    {
+        table.expire(now);
+        bool markdown = false;
+        const char *cached = cache.lookup(reply, generation(reply), now, maxAge(reply), markdown);
+        if (cached) {
+            return cached;
+        }
+        renders[(size_t)reply]++;
+        render.clear();
+        if (reply == CachedReply::NODES) {
+            renderNodes();
+        } else {
+            render.addf("reply %u at generation %u", (unsigned)reply, generation(reply));
+        }
+        cache.store(reply, generation(reply), now, render, true);
+        return render.c_str();
+    }
+
+    // Bit n set if reply n was rendered again when every command ran once more
+    uint8_t rerendered()
+    {
+        uint8_t mask = 0;
+        for (CachedReply reply : REPLIES) {
+            uint32_t before = renders[(size_t)reply];
+            run(reply);
+            mask |= (renders[(size_t)reply] != before) << (uint8_t)reply;
+        }
+        return mask;
+    }
+};
+
+static Gateway *gw;
+
+void setUp(void)
+{
+    gw = new Gateway();
+    for (NodeNum num = 0x1000; num < 0x100c; num++) {
+        TrackedNode *node = gw->table.touch(num, 0);
+        gw->table.setName(*node, "node");
+        if (num % 2) {
+            gw->table.setLocation(*node, 520000000 + num, 130000000, 10);
+        }
+    }
+    gw->rerendered();
+}
+
+void tearDown(void)
+{
+    delete gw;
+}
+
+#define NODES_BIT (1 << (uint8_t)CachedReply::NODES)
+#define MAP_BIT (1 << (uint8_t)CachedReply::MAP)
+#define STATUS_BIT (1 << (uint8_t)CachedReply::STATUS)
+
+static void test_repeated_commands_render_once(void)
+{
+    uint32_t hits = gw->cache.stats().hits;
+    for (int member = 0; member < 20; member++) {
+        TEST_ASSERT_EQUAL_UINT8(0, gw->rerendered());
+    }
+    for (CachedReply reply : REPLIES) {
+        TEST_ASSERT_EQUAL_UINT32(1, gw->renders[(size_t)reply]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(hits + 80, gw->cache.stats().hits);
+}
+
+static void test_each_change_invalidates_exactly_what_shows_it(void)
+{
+    TelegramNodeTable &table = gw->table;
+    gw->now = 1000;
+
+    table.touch(0x1003, gw->now); // Heard again
+    TEST_ASSERT_EQUAL_UINT8(0, gw->rerendered());
+    table.setName(*table.find(0x1003), "node");
+    TEST_ASSERT_EQUAL_UINT8(0, gw->rerendered());
+    table.setLocation(*table.find(0x1003), 520000000 + 0x1003, 130000000, 45); // Only the altitude
+    TEST_ASSERT_EQUAL_UINT8(0, gw->rerendered());
+
+    table.setName(*table.find(0x1003), "renamed");
+    TEST_ASSERT_EQUAL_UINT8(NODES_BIT | STATUS_BIT, gw->rerendered());
+    table.touch(0x2000, gw->now); // New, no location yet
+    TEST_ASSERT_EQUAL_UINT8(NODES_BIT | STATUS_BIT, gw->rerendered());
+    table.setLocation(*table.find(0x2000), 525200000, 134050000, 30); // First fix
+    TEST_ASSERT_EQUAL_UINT8(NODES_BIT | MAP_BIT | STATUS_BIT, gw->rerendered());
+    table.setLocation(*table.find(0x1001), 525300000, 134050000, 30); // Moved
+    TEST_ASSERT_EQUAL_UINT8(NODES_BIT | MAP_BIT | STATUS_BIT, gw->rerendered());
+
+    // Everything but 0x1003 and 0x2000 goes stale, located nodes among them; an hour on,
+    // /config has run out its age too
+    for (gw->now = 1000; gw->now < TIMEOUT_MS + 2 * TELEGRAM_WHEEL_TICK_MS; gw->now += 60000) {
+        table.touch(0x1003, gw->now);
+        table.touch(0x2000, gw->now);
+    }
+    TEST_ASSERT_EQUAL_UINT8(NODES_BIT | MAP_BIT | STATUS_BIT | (1 << (uint8_t)CachedReply::CONFIG), gw->rerendered());
+    TEST_ASSERT_EQUAL_UINT32(2, table.size());
+    TEST_ASSERT_EQUAL_UINT8(0, gw->rerendered());
+}
+
+static void test_age_caps(void)
+{
+    // Nothing changes; only replies with times in them run out
+    gw->now = STATUS_CACHE_MS;
+    TEST_ASSERT_EQUAL_UINT8(STATUS_BIT, gw->rerendered());
+    gw->now = NODES_CACHE_MS;
+    TEST_ASSERT_EQUAL_UINT8(NODES_BIT | STATUS_BIT, gw->rerendered());
+    gw->now = CONFIG_CACHE_MS;
+    TEST_ASSERT_EQUAL_UINT8(NODES_BIT | STATUS_BIT | (1 << (uint8_t)CachedReply::CONFIG), gw->rerendered());
+    TEST_ASSERT_EQUAL_UINT32(6, gw->cache.stats().expired);
+    TEST_ASSERT_EQUAL_UINT32(1, gw->renders[(size_t)CachedReply::MAP]);
+}
+
+static void test_oversize_reply_is_not_served_stale(void)
+{
+    TelegramTextBuffer<4000> big;
+    for (int i = 0; i < 300; i++) {
+        big.add("0123456789");
+    }
+    uint32_t generation = gw->generation(CachedReply::MAP);
+    bool markdown;
+    TEST_ASSERT_NOT_NULL(gw->cache.lookup(CachedReply::MAP, generation, 0, 0, markdown));
+    TEST_ASSERT_FALSE(gw->cache.store(CachedReply::MAP, generation + 1, 0, big, true));
+    TEST_ASSERT_NULL(gw->cache.lookup(CachedReply::MAP, generation, 0, 0, markdown));
+    TEST_ASSERT_EQUAL_UINT32(1, gw->cache.stats().uncacheable);
+}
+
+static void test_benchmark_render_against_hit(void)
+{
+    for (NodeNum num = 0x3000; num < 0x3000 + 38; num++) {
+        TrackedNode *node = gw->table.touch(num, 0);
+        gw->table.setName(*node, "Some Long Name");
+        gw->table.setLocation(*node, 520000000 + num * 1000, 130000000 + num * 777, 0);
+    }
+    using Clock = std::chrono::steady_clock;
+    const int commands = 20000;
+    size_t bytes = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < commands; i++) {
+        gw->render.clear();
+        gw->renderNodes();
+        bytes += gw->render.length();
+    }
+    double renderUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / commands;
+    size_t length = gw->render.length();
+
+    gw->run(CachedReply::NODES);
+    start = Clock::now();
+    for (int i = 0; i < commands; i++) {
+        bytes += strlen(gw->run(CachedReply::NODES));
+    }
+    double hitUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / commands;
+    TEST_ASSERT_TRUE(bytes > 0);
+    TEST_ASSERT_LESS_THAN(renderUs, hitUs);
+
+    char line[128];
+    snprintf(line, sizeof(line), "/nodes for %u nodes, %u bytes: %.2f us rendered, %.3f us from the cache",
+             (unsigned)gw->table.size(), (unsigned)length, renderUs, hitUs);
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_repeated_commands_render_once);
+    RUN_TEST(test_each_change_invalidates_exactly_what_shows_it);
+    RUN_TEST(test_age_caps);
+    RUN_TEST(test_oversize_reply_is_not_served_stale);
+    RUN_TEST(test_benchmark_render_against_hit);
+    return UNITY_END();
+}
@@ -0,0 +1,203 @@
+// TelegramRoutes: the documented table parsed and matched, lines that do not parse skipped with
+// nothing left behind, the table read from its file, and the cost of matching a packet with 1
+// and with 200 rules
+
+#include "FSCommon.h"
+#include "TelegramRoutes.h"
+#include "mesh/generated/meshtastic/portnums.pb.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <unity.h>
+
+#define TEXT meshtastic_PortNum_TEXT_MESSAGE_APP
+#define POSITION meshtastic_PortNum_POSITION_APP
+#define TELEMETRY meshtastic_PortNum_TELEMETRY_APP
+
+static TelegramRoutes routes;
+
+void setUp(void)
+{
+    hostFiles.clear();
+}
+
+void tearDown(void) {}
+
+static uint8_t matchText(NodeNum from, uint8_t channel, const char *text)
+{
+    return routes.match(TEXT, from, channel, text, strlen(text));
+}
+
+static void test_documented_table(void)
+{
+    // The example in TelegramRoutes.h
+    const char *table = "# Lane 0 is always the chat_id from the configuration\n"
+                        "lane 1 -1001234567890          # another chat\n"
+                        "lane 2 -1009876543210:42       # topic 42 of a forum group\n"
+                        "from=!a1b2c3d4 -> drop         # a chatty sensor\n"
+                        "port=text keyword=sos -> 0,1\n"
+                        "port=telemetry -> 2\n"
+                        "channel=1 -> 1\n"
+                        "default 0                      # what matches no rule\n";
+    TEST_ASSERT_EQUAL_UINT32(4, routes.compile(table));
+    TEST_ASSERT_EQUAL_UINT32(0, routes.stats().errors);
+    TEST_ASSERT_EQUAL_STRING("-1001234567890", routes.lane(1).chatId);
+    TEST_ASSERT_EQUAL_INT32(0, routes.lane(1).threadId);
+    TEST_ASSERT_EQUAL_STRING("-1009876543210", routes.lane(2).chatId);
+    TEST_ASSERT_EQUAL_INT32(42, routes.lane(2).threadId);
+
+    TEST_ASSERT_EQUAL_UINT8(0, matchText(0xa1b2c3d4, 0, "SOS"));
+    TEST_ASSERT_EQUAL_UINT8(0x3, matchText(7, 0, "need help, SOS!"));
+    TEST_ASSERT_EQUAL_UINT8(0x1, matchText(7, 0, "sosa is a word")); // Whole words only
+    TEST_ASSERT_EQUAL_UINT8(0x2, matchText(7, 1, "hello"));
+    TEST_ASSERT_EQUAL_UINT8(0x4, routes.match(TELEMETRY, 7, 1, nullptr, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x1, routes.match(POSITION, 7, 0, nullptr, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, routes.match(POSITION, 0xa1b2c3d4, 0, nullptr, 0));
+    TEST_ASSERT_EQUAL_UINT32(2, routes.stats().dropped);
+
+    routes.compile("port=position -> drop\ndefault drop\n");
+    TEST_ASSERT_EQUAL_UINT8(0, routes.match(POSITION, 7, 0, nullptr, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, matchText(7, 0, "hi"));
+
+    // No table: everything to the configured chat
+    TEST_ASSERT_EQUAL_UINT32(0, routes.compile(""));
+    TEST_ASSERT_EQUAL_UINT8(0x1, matchText(7, 3, "hi"));
+}
+
+static void test_bad_lines_are_skipped(void)
+{
+    const char *table = "lane 1 -1001234567890123456789012345\n" // 36 characters, more than a chat id holds
+                        "lane 2 -100987:7\n"
+                        "port=txt -> 2\n"                          // No such port
+                        "port=67x -> 2\n"
+                        "port=text -> 1\n"                         // Lane 1 never got a chat
+                        "channel=9 -> 2\n"
+                        "keyword=a-b -> 2\n"
+                        "from=!1 ->\n"
+                        "port=position\n"
+                        "lane 3 -100\n"
+                        "default 5\n"                              // Leaves the default as it was
+                        "port=67 -> 2\n"                           // Numeric ports are fine
+                        "port=text -> 0\n";
+    TEST_ASSERT_EQUAL_UINT32(2, routes.compile(table));
+    TEST_ASSERT_EQUAL_UINT32(10, routes.stats().errors);
+    TEST_ASSERT_FALSE(routes.hasLane(1));
+    TEST_ASSERT_EQUAL_STRING("", routes.lane(1).chatId);
+    TEST_ASSERT_EQUAL_INT32(0, routes.lane(1).threadId);
+    TEST_ASSERT_EQUAL_STRING("-100987", routes.lane(2).chatId);
+
+    // The skipped rules left nothing behind: port 0 in particular matches nothing
+    TEST_ASSERT_EQUAL_UINT8(0x4, routes.match(TELEMETRY, 7, 0, nullptr, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x1, matchText(7, 0, "hi"));
+    TEST_ASSERT_EQUAL_UINT8(0x1, routes.match(meshtastic_PortNum_UNKNOWN_APP, 7, 0, nullptr, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x1, matchText(7, 0, "a b a-b"));
+
+    // A chat id that just fits is kept whole
+    std::string longest = "lane 1 " + std::string(sizeof(RouteLane::chatId) - 1, '9') + ":3\n";
+    routes.compile(longest.c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, routes.stats().errors);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(RouteLane::chatId) - 1, strlen(routes.lane(1).chatId));
+    TEST_ASSERT_EQUAL_INT32(3, routes.lane(1).threadId);
+}
+
+static void test_rules_beyond_the_limit_are_skipped(void)
+{
+    std::string table;
+    for (int i = 0; i < TELEGRAM_ROUTE_RULES_MAX + 3; i++) {
+        char line[32];
+        snprintf(line, sizeof(line), "from=!%x -> drop\n", 0x1000 + i);
+        table += line;
+    }
+    TEST_ASSERT_EQUAL_UINT32(TELEGRAM_ROUTE_RULES_MAX, routes.compile(table.c_str()));
+    TEST_ASSERT_EQUAL_UINT32(3, routes.stats().errors);
+    TEST_ASSERT_EQUAL_UINT8(0, routes.match(TEXT, 0x1000, 0, nullptr, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x1, routes.match(TEXT, 0x1000 + TELEGRAM_ROUTE_RULES_MAX, 0, nullptr, 0));
+}
+
+static void test_loads_from_file(void)
+{
+    routes.load();
+    TEST_ASSERT_EQUAL_UINT32(0, routes.stats().rules);
+    TEST_ASSERT_EQUAL_UINT8(0x1, routes.match(TELEMETRY, 7, 0, nullptr, 0));
+
+    const char *table = "lane 1 -100\nport=telemetry -> 1\n";
+    hostFiles["/telegram/routes.txt"] = std::vector<uint8_t>(table, table + strlen(table));
+    routes.load();
+    TEST_ASSERT_EQUAL_UINT32(1, routes.stats().rules);
+    TEST_ASSERT_EQUAL_UINT8(0x2, routes.match(TELEMETRY, 7, 0, nullptr, 0));
+}
+
+// ns per match over a mix of senders and channels
+static double nsPerMatch(uint32_t port, const char *text)
+{
+    static uint32_t senders[4096];
+    std::mt19937 rng(1);
+    for (uint32_t &s : senders) {
+        s = rng();
+    }
+    const int packets = 1000000;
+    unsigned lanes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < packets; i++) {
+        lanes += routes.match(port, senders[i & 4095], i & 7, text, text ? strlen(text) : 0);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / packets;
+    TEST_ASSERT_TRUE(lanes > 0);
+    return ns;
+}
+
+static void test_benchmark_1_vs_200_rules(void)
+{
+    const char *message = "hello everyone, this is a test of the mesh gateway near the w123 trail";
+    double ns[2][2];
+    for (int big = 0; big < 2; big++) {
+        // Senders dropped, keyword and port/channel rules, telemetry from some nodes to two chats
+        std::mt19937 rng(2);
+        std::string table = "lane 1 -1001\nlane 2 -1002\n";
+        for (int i = 0; big && i < 199; i++) {
+            char line[64];
+            switch (i % 4) {
+            case 0:
+                snprintf(line, sizeof(line), "from=!%08x -> drop\n", (unsigned)rng());
+                break;
+            case 1:
+                snprintf(line, sizeof(line), "port=text keyword=w%u -> 1\n", (unsigned)(rng() % 100000));
+                break;
+            case 2:
+                snprintf(line, sizeof(line), "port=%u channel=%u -> 2\n", (unsigned)(rng() % 300 + 100),
+                         (unsigned)(rng() % 8));
+                break;
+            default:
+                snprintf(line, sizeof(line), "from=!%08x port=telemetry -> 0,2\n", (unsigned)rng());
+                break;
+            }
+            table += line;
+        }
+        table += "port=text keyword=sos -> 0,1\n";
+        TEST_ASSERT_EQUAL_UINT32(big ? 200 : 1, routes.compile(table.c_str()));
+        ns[big][0] = nsPerMatch(TELEMETRY, nullptr);
+        ns[big][1] = nsPerMatch(TEXT, message);
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "  1 rule:  %6.1f ns/packet telemetry, %6.1f ns/packet for %u bytes of text", ns[0][0],
+             ns[0][1], (unsigned)strlen(message));
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "200 rules: %6.1f ns/packet telemetry, %6.1f ns/packet for %u bytes of text", ns[1][0],
+             ns[1][1], (unsigned)strlen(message));
+    TEST_MESSAGE(line);
+    // Eight bitset words instead of one; no walk over the rules
+    TEST_ASSERT_LESS_THAN(4 * ns[0][0] + 20, ns[1][0]);
+    TEST_ASSERT_LESS_THAN(2 * ns[0][1], ns[1][1]);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_documented_table);
+    RUN_TEST(test_bad_lines_are_skipped);
+    RUN_TEST(test_rules_beyond_the_limit_are_skipped);
+    RUN_TEST(test_loads_from_file);
+    RUN_TEST(test_benchmark_1_vs_200_rules);
+    return UNITY_END();
+}
@@ -0,0 +1,215 @@
+// TelegramSpool behind the outbox through a 10-minute outage: every forward delivered once and
+// in order afterwards, a reset mid-replay, and an outage longer than the ring holds; flash files
+// opened and drain time
+
+#include "FSCommon.h"
+#include "TelegramOutbox.h"
+#include "TelegramSpool.h"
+#include <memory>
+#include <unity.h>
+#include <vector>
+
+#define TELEGRAM_MESSAGE_LIMIT 4096 // From TelegramModule.h
+#define SEND_INTERVAL_MS 3000       // A batch per 3 s keeps under Telegram's 20 per minute
+
+// The outbox, the spool and the parts of TelegramModule between them: drainForwards() for one
+// forward, refillFromSpool() and the ok branch of flushing a lane
+struct Gateway {
+    TelegramOutbox outbox;
+    TelegramSpool spool;
+    uint32_t nextSendAt = 0;
+
+    Gateway() { spool.begin(); }
+
+    void forward(uint32_t id)
+    {
+        char text[160];
+        int len = snprintf(text, sizeof(text),
+                           "\xF0\x9F\x93\xA1 *Node !%08x* (Hilltop relay): message %u, SNR 6.25 RSSI -97, 3 hops",
+                           0xa1b2c3d4, (unsigned)id);
+        if (spool.isReady() && (outbox.isFull() || spool.hasPending())) {
+            TEST_ASSERT_TRUE(spool.append(text, len));
+        } else {
+            outbox.push(text, len, 0);
+        }
+    }
+
+    void refill()
+    {
+        char text[TELEGRAM_OUTBOX_TEXT_MAX];
+        uint32_t seq;
+        while (spool.hasPending() && !outbox.isFull()) {
+            size_t len = spool.next(text, sizeof(text), seq);
+            if (len == 0) {
+                break;
+            }
+            outbox.push(text, len, 0, seq);
+        }
+    }
+
+    void send(uint32_t now, std::vector<uint32_t> &delivered)
+    {
+        refill();
+        if (outbox.isEmpty() || (int32_t)(now - nextSendAt) < 0) {
+            return;
+        }
+        size_t count = outbox.batchCount(TELEGRAM_MESSAGE_LIMIT);
+        uint32_t spooled = 0;
+        for (size_t i = 0; i < count; i++) {
+            const OutboxItem *item = outbox.peekAt(i);
+            delivered.push_back(atol(strstr(item->text, "message ") + 8));
+            if (item->spoolSeq) {
+                spooled = item->spoolSeq;
+            }
+        }
+        outbox.completeFront(count);
+        if (spooled) {
+            spool.ack(spooled, now);
+        }
+        nextSendAt = now + SEND_INTERVAL_MS;
+    }
+};
+
+void setUp(void)
+{
+    hostFiles.clear();
+    hostWriteBudget = -1;
+    hostFileOpens = 0;
+    hostSetMillis(0);
+}
+
+void tearDown(void) {}
+
+static size_t segmentFiles()
+{
+    size_t n = 0;
+    for (const auto &file : hostFiles) {
+        n += file.first.compare(0, 9, "/tgspool/") == 0 && file.first != "/tgspool/cursor";
+    }
+    return n;
+}
+
+static void test_ten_minute_outage(void)
+{
+    // A forward every 2 s; the link is down for the first 10 minutes
+    const uint32_t outageMs = 600000, intervalMs = 2000, totalMs = 900000;
+    Gateway gw;
+    std::vector<uint32_t> delivered;
+    uint32_t sent = 0, recoveredAt = 0, drainedAt = 0;
+
+    for (uint32_t now = 0; now < 3600000 && (now < totalMs || delivered.size() < sent); now += 100) {
+        hostSetMillis(now);
+        if (now < totalMs && now % intervalMs == 0) {
+            gw.forward(sent++);
+        }
+        if (now >= outageMs) {
+            recoveredAt = recoveredAt ? recoveredAt : now;
+            gw.send(now, delivered);
+            if (!drainedAt && gw.spool.backlog() == 0) {
+                drainedAt = now;
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(sent, delivered.size());
+    for (uint32_t i = 0; i < sent; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, delivered[i]);
+    }
+    const SpoolStats &stats = gw.spool.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped + stats.writeErrors);
+    TEST_ASSERT_EQUAL_UINT32(0, gw.outbox.stats().droppedOverflow);
+    TEST_ASSERT_TRUE(stats.highWater >= outageMs / intervalMs - TELEGRAM_OUTBOX_DEPTH);
+    TEST_ASSERT_EQUAL_UINT32(0, gw.spool.backlog());
+    TEST_ASSERT_EQUAL_size_t(0, segmentFiles()); // Delivered segments are deleted, not rewritten
+
+    char line[200];
+    snprintf(line, sizeof(line),
+             "%u forwards, %u spooled (high water %u), backlog drained %.0f s after the link came back, %u file "
+             "opens for writing",
+             sent, stats.spooled, stats.highWater, (drainedAt - recoveredAt) / 1000.0, hostFileOpens);
+    TEST_MESSAGE(line);
+}
+
+static void test_reset_during_replay_loses_nothing(void)
+{
+    const uint32_t outageMs = 600000, intervalMs = 2000, resetAt = 645000;
+    std::unique_ptr<Gateway> gw(new Gateway());
+    std::vector<uint32_t> delivered;
+    uint32_t sent = 0;
+
+    for (uint32_t now = 0; now < outageMs; now += intervalMs) {
+        hostSetMillis(now);
+        gw->forward(sent++);
+    }
+    uint32_t spooled = gw->spool.backlog();
+    for (uint32_t now = outageMs; now < resetAt; now += 100) {
+        hostSetMillis(now);
+        gw->send(now, delivered);
+    }
+    size_t beforeReset = delivered.size();
+
+    // The outbox is RAM and goes; the spool comes back from flash, at most a cursor interval behind
+    gw.reset(new Gateway());
+    TEST_ASSERT_TRUE(gw->spool.isReady());
+    // Spool record 1 is the first forward that found the outbox full
+    uint32_t replayFrom = TELEGRAM_OUTBOX_DEPTH + spooled - gw->spool.backlog();
+    for (uint32_t now = resetAt; gw->spool.backlog() > 0 || !gw->outbox.isEmpty(); now += 100) {
+        hostSetMillis(now);
+        gw->send(now, delivered);
+    }
+
+    // Replay picks up where the last cursor write left off: nothing is lost, and only what was
+    // delivered since that write is sent again
+    TEST_ASSERT_TRUE(replayFrom <= delivered[beforeReset - 1] + 1);
+    uint32_t repeated = delivered[beforeReset - 1] + 1 - replayFrom;
+    TEST_ASSERT_TRUE(repeated <= (TELEGRAM_SPOOL_CURSOR_MS / SEND_INTERVAL_MS + 1) * TELEGRAM_OUTBOX_DEPTH);
+    TEST_ASSERT_EQUAL_UINT32(sent - replayFrom, delivered.size() - beforeReset);
+    for (size_t i = beforeReset; i < delivered.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(replayFrom + (i - beforeReset), delivered[i]);
+    }
+
+    char line[120];
+    snprintf(line, sizeof(line), "reset mid-replay: %u message(s) sent again, none lost", repeated);
+    TEST_MESSAGE(line);
+}
+
+static void test_outage_beyond_the_ring_drops_oldest(void)
+{
+    // Two forwards a second for 10 minutes is more than 64 KB of spool
+    const uint32_t outageMs = 600000, intervalMs = 500;
+    Gateway gw;
+    std::vector<uint32_t> delivered;
+    uint32_t sent = 0;
+
+    for (uint32_t now = 0; now < outageMs; now += intervalMs) {
+        hostSetMillis(now);
+        gw.forward(sent++);
+    }
+    for (uint32_t now = outageMs; gw.spool.backlog() > 0 || !gw.outbox.isEmpty(); now += 100) {
+        hostSetMillis(now);
+        gw.send(now, delivered);
+    }
+
+    const SpoolStats &stats = gw.spool.stats();
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(sent, delivered.size() + stats.dropped);
+    for (size_t i = 1; i < delivered.size(); i++) {
+        TEST_ASSERT_TRUE(delivered[i] > delivered[i - 1]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(sent - 1, delivered.back()); // The newest survive
+    TEST_ASSERT_TRUE(segmentFiles() <= TELEGRAM_SPOOL_SEGMENTS);
+
+    char line[120];
+    snprintf(line, sizeof(line), "%u forwards in 10 minutes: %u delivered, %u oldest given up", sent,
+             (unsigned)delivered.size(), stats.dropped);
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ten_minute_outage);
+    RUN_TEST(test_reset_during_replay_loses_nothing);
+    RUN_TEST(test_outage_beyond_the_ring_drops_oldest);
+    return UNITY_END();
+}
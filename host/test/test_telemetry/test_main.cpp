@@ -0,0 +1,235 @@
+// TelegramTelemetry over a replayed day of a 30-node mesh: device, environment, power and air
+// quality telemetry at their usual intervals, hourly digests checked against the readings, change
+// reports only when a metric moves by its delta; chat messages against one per packet
+
+#include "TelegramTelemetry.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+#define DAY_MS 86400000UL
+#define MINUTE_MS 60000UL
+#define BATCH_LIMIT 4096 // The outbox joins digest items into messages of up to this
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+enum class Kind { DEVICE, BATTERY, ENVIRONMENT, POWER, AIR_QUALITY };
+
+struct SimNode {
+    NodeNum num;
+    Kind kind;
+    uint32_t periodMin;
+    uint32_t phaseMin;
+};
+
+static int16_t stored(float value, int scale)
+{
+    return (int16_t)std::lround(value * scale);
+}
+
+// What each node reports at minute m of the day
+static meshtastic_Telemetry reading(const SimNode &node, uint32_t m)
+{
+    meshtastic_Telemetry t = meshtastic_Telemetry_init_zero;
+    double day = m / 1440.0;
+    switch (node.kind) {
+    case Kind::DEVICE:
+    case Kind::BATTERY: {
+        t.which_variant = meshtastic_Telemetry_device_metrics_tag;
+        meshtastic_DeviceMetrics &d = t.variant.device_metrics;
+        d.has_battery_level = d.has_voltage = d.has_channel_utilization = d.has_air_util_tx = true;
+        // Solar nodes report external power; battery nodes drain from 100% to about 40% over the day
+        d.battery_level = node.kind == Kind::BATTERY ? (uint32_t)(100 - 60 * day) : 101;
+        d.voltage = node.kind == Kind::BATTERY ? 3.3f + 0.9f * d.battery_level / 100 : 4.2f;
+        d.channel_utilization = 8 + 6 * std::sin(day * 2 * M_PI) + (m * 7 + node.num) % 5;
+        d.air_util_tx = 0.5f + (m + node.num) % 3 * 0.3f;
+        break;
+    }
+    case Kind::ENVIRONMENT: {
+        t.which_variant = meshtastic_Telemetry_environment_metrics_tag;
+        meshtastic_EnvironmentMetrics &e = t.variant.environment_metrics;
+        e.has_temperature = e.has_relative_humidity = e.has_barometric_pressure = true;
+        // 7 °C at dawn, 23 °C mid-afternoon
+        e.temperature = 15 - 8 * std::cos((day - 0.125) * 2 * M_PI);
+        e.relative_humidity = 70 + 20 * std::cos((day - 0.125) * 2 * M_PI);
+        e.barometric_pressure = 1013 - 6 * day;
+        break;
+    }
+    case Kind::POWER: {
+        t.which_variant = meshtastic_Telemetry_power_metrics_tag;
+        meshtastic_PowerMetrics &p = t.variant.power_metrics;
+        p.has_ch1_voltage = p.has_ch1_current = true;
+        p.ch1_voltage = 12.8f - 0.5f * day;
+        p.ch1_current = 120 + (m * 37 + node.num) % 60;
+        break;
+    }
+    case Kind::AIR_QUALITY: {
+        t.which_variant = meshtastic_Telemetry_air_quality_metrics_tag;
+        meshtastic_AirQualityMetrics &a = t.variant.air_quality_metrics;
+        a.has_pm25_standard = true;
+        a.pm25_standard = 12 + (m >= 420 && m < 540 ? 40 : 0); // Morning traffic
+        break;
+    }
+    }
+    return t;
+}
+
+static std::vector<SimNode> mesh()
+{
+    // Device telemetry every 30 min, sensors every 15, power every 5, air quality every 10
+    std::vector<SimNode> nodes;
+    NodeNum num = 0x1000;
+    for (int i = 0; i < 16; i++) {
+        nodes.push_back({num++, Kind::DEVICE, 30, (uint32_t)i % 30});
+    }
+    for (int i = 0; i < 6; i++) {
+        nodes.push_back({num++, Kind::BATTERY, 30, (uint32_t)i * 4});
+    }
+    for (int i = 0; i < 5; i++) {
+        nodes.push_back({num++, Kind::ENVIRONMENT, 15, (uint32_t)i * 3});
+    }
+    nodes.push_back({num++, Kind::POWER, 5, 1});
+    nodes.push_back({num++, Kind::POWER, 5, 3});
+    nodes.push_back({num++, Kind::AIR_QUALITY, 10, 2});
+    return nodes;
+}
+
+static void test_day_of_telemetry(void)
+{
+    std::vector<SimNode> nodes = mesh();
+    TelegramTelemetry telemetry;
+    uint32_t packets = 0, changeMessages = 0, digestItems = 0, digestMessages = 0;
+    uint32_t batteryReports = 0, temperatureReports = 0;
+    size_t digestBytes = 0, pendingBatch = 0;
+
+    // The first environment node's temperature over the current window, to check its digest line
+    const SimNode &watched = nodes[22];
+    std::vector<int16_t> window;
+    uint32_t digestsChecked = 0;
+
+    // One minute past the day for its last digest
+    for (uint32_t m = 0; m <= DAY_MS / MINUTE_MS; m++) {
+        uint32_t now = m * MINUTE_MS + 1;
+        for (const SimNode &node : nodes) {
+            if (m == DAY_MS / MINUTE_MS || (m + node.phaseMin) % node.periodMin != 0) {
+                continue;
+            }
+            meshtastic_Telemetry t = reading(node, m);
+            TelegramTextBuffer<384> changes;
+            packets++;
+            if (telemetry.ingest(node.num, 0, t, now, changes) > 0) {
+                changeMessages++;
+                std::string text = changes.c_str();
+                batteryReports += text.find("*Battery:*") != std::string::npos;
+                temperatureReports += text.find("*Temperature:*") != std::string::npos;
+            }
+            if (node.num == watched.num) {
+                window.push_back(stored(t.variant.environment_metrics.temperature, 10));
+            }
+        }
+
+        if (!telemetry.digestDue(now)) {
+            continue;
+        }
+        for (size_t i = 0; i < telemetry.size(); i++) {
+            TelegramTextBuffer<384> out;
+            out.add("📊 *Telemetry, last 60 min*\n*From:* Node\n");
+            bool watchedNode = telemetry.nodeAt(i) == watched.num;
+            if (!telemetry.renderDigest(i, out)) {
+                continue;
+            }
+            digestItems++;
+            digestBytes += out.length();
+            if (pendingBatch == 0 || pendingBatch + 2 + out.length() > BATCH_LIMIT) {
+                digestMessages++;
+                pendingBatch = out.length();
+            } else {
+                pendingBatch += 2 + out.length();
+            }
+
+            if (watchedNode && !window.empty()) {
+                int32_t sum = 0;
+                int16_t lo = window[0], hi = window[0];
+                for (int16_t v : window) {
+                    sum += v;
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+                int32_t mean = (sum + (int32_t)window.size() / 2) / (int32_t)window.size();
+                TelegramTextBuffer<128> expected;
+                expected.add("*Temperature:* ");
+                TelegramTelemetry::addValue(expected, TelemetryMetric::TEMPERATURE, mean);
+                if (lo != hi) {
+                    expected.add(" (");
+                    TelegramTelemetry::addValue(expected, TelemetryMetric::TEMPERATURE, lo, false);
+                    expected.add(" – ");
+                    TelegramTelemetry::addValue(expected, TelemetryMetric::TEMPERATURE, hi);
+                    expected.add(")");
+                }
+                TEST_ASSERT_MESSAGE(strstr(out.c_str(), expected.c_str()) != nullptr, out.c_str());
+                window.clear();
+                digestsChecked++;
+            }
+        }
+        pendingBatch = 0;
+        telemetry.finishDigest(now);
+    }
+
+    const TelemetryStats &stats = telemetry.stats();
+    TEST_ASSERT_EQUAL_UINT32(24, stats.digests);
+    TEST_ASSERT_EQUAL_UINT32(24, digestsChecked);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.evicted);
+    TEST_ASSERT_EQUAL_UINT32(nodes.size(), telemetry.size());
+    TEST_ASSERT_EQUAL_UINT32(24 * nodes.size(), digestItems);
+
+    // Each node's first reading, then each battery node at 90, 80, 70, 60 and 50%; the last
+    // reading of the day is 41%
+    TEST_ASSERT_EQUAL_UINT32(16 + 6 * 6, batteryReports);
+    // Each sensor: the first reading, then every 2 °C of a 16 °C swing down and back up
+    TEST_ASSERT_TRUE(temperatureReports >= 5 * 8 && temperatureReports <= 5 * 17);
+    uint32_t chatMessages = changeMessages + digestMessages;
+    TEST_ASSERT_TRUE(chatMessages * 5 < packets);
+
+    char line[240];
+    snprintf(line, sizeof(line),
+             "a day of %u telemetry packets from %u nodes: %u change reports and %u digest messages (%u node "
+             "digests, %u bytes) instead of %u messages",
+             packets, (unsigned)nodes.size(), changeMessages, digestMessages, digestItems, (unsigned)digestBytes,
+             packets);
+    TEST_MESSAGE(line);
+}
+
+static void test_full_table_gives_up_the_quietest_node(void)
+{
+    TelegramTelemetry telemetry;
+    TelegramTextBuffer<384> changes;
+    meshtastic_Telemetry t = reading({0, Kind::DEVICE, 30, 0}, 0);
+    for (NodeNum num = 1; num <= TELEGRAM_TELEMETRY_NODES; num++) {
+        telemetry.ingest(num, 0, t, num * 1000, changes);
+    }
+    telemetry.ingest(1, 0, t, 100000, changes); // Node 1 is heard again; node 2 is now the quietest
+    telemetry.ingest(999, 0, t, 101000, changes);
+
+    TEST_ASSERT_EQUAL_UINT32(1, telemetry.stats().evicted);
+    TEST_ASSERT_EQUAL_UINT32(TELEGRAM_TELEMETRY_NODES, telemetry.size());
+    bool has1 = false, has2 = false, has999 = false;
+    for (size_t i = 0; i < telemetry.size(); i++) {
+        has1 |= telemetry.nodeAt(i) == 1;
+        has2 |= telemetry.nodeAt(i) == 2;
+        has999 |= telemetry.nodeAt(i) == 999;
+    }
+    TEST_ASSERT_TRUE(has1 && !has2 && has999);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_day_of_telemetry);
+    RUN_TEST(test_full_table_gives_up_the_quietest_node);
+    return UNITY_END();
+}
@@ -0,0 +1,144 @@
+// TelegramText: escaping, fixed-point coordinates, durations, UTF-8-safe
+// truncation, and rendering a forwarded packet without touching the heap
+
+#include "TelegramText.h"
+#include <new>
+#include <stdlib.h>
+#include <string>
+#include <unity.h>
+
+// Every heap allocation in the process goes through here
+static size_t allocations;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_escapes_markdown_entities(void)
+{
+    TelegramTextBuffer<64> text;
+    text.addEscaped("my_node *1* `x` [y]");
+    TEST_ASSERT_EQUAL_STRING("my\\_node \\*1\\* \\`x\\` \\[y]", text.c_str());
+    TEST_ASSERT_FALSE(text.truncated());
+
+    // Mesh payloads may carry trailing NULs inside their length
+    text.clear();
+    text.addEscaped("hi\0\0", 4);
+    TEST_ASSERT_EQUAL_size_t(2, text.length());
+}
+
+static void test_degrees_round_to_six_places(void)
+{
+    TelegramTextBuffer<96> text;
+    text.addDegrees(-338688200).add(" ").addDegrees(5).add(" ").addDegrees(-5).add(" ").addDegrees(1799999996);
+    TEST_ASSERT_EQUAL_STRING("-33.868820 0.000001 -0.000001 180.000000", text.c_str());
+}
+
+static void test_time_ago_and_durations(void)
+{
+    TelegramTextBuffer<96> text;
+    text.addTimeAgo(850).add(",").addTimeAgo(12000).add(",").addTimeAgo(61000).add(",").addTimeAgo(3 * 3600000 + 5);
+    TEST_ASSERT_EQUAL_STRING("850ms ago,12s ago,1m ago,3h ago", text.c_str());
+    text.clear();
+    text.addDuration(850).add(",").addDuration(12345).add(",").addDuration(4250000);
+    TEST_ASSERT_EQUAL_STRING("850us,12.3ms,4.2s", text.c_str());
+}
+
+static void test_truncates_on_character_boundaries(void)
+{
+    // "ab" and one 2-byte "é" fit in 7 bytes; the second "é" would be cut in half
+    TelegramTextBuffer<8> added;
+    added.add("ab").add("\xC3\xA9\xC3\xA9\xC3\xA9");
+    TEST_ASSERT_EQUAL_STRING("ab\xC3\xA9\xC3\xA9", added.c_str());
+    TEST_ASSERT_TRUE(added.truncated());
+    added.add("more");
+    TEST_ASSERT_EQUAL_size_t(6, added.length());
+
+    TelegramTextBuffer<8> formatted;
+    formatted.addf("%s", "abcd\xC3\xA9\xE2\x82\xAC");
+    TEST_ASSERT_EQUAL_STRING("abcd\xC3\xA9", formatted.c_str());
+    TEST_ASSERT_TRUE(formatted.truncated());
+
+    // An escape never loses its character
+    TelegramTextBuffer<8> escaped;
+    escaped.addEscaped("a_b_c_d");
+    TEST_ASSERT_EQUAL_STRING("a\\_b\\_c", escaped.c_str());
+    TEST_ASSERT_TRUE(escaped.truncated());
+}
+
+// A forwarded text message with a position line, shaped like what
+// sendTextToTelegram and sendPositionToTelegram render
+static void renderPacket(TelegramText &text)
+{
+    text.add("\xF0\x9F\x92\xAC *").addEscaped("Base_Camp").add("* (!a1b2c3d4)\n");
+    text.addEscaped("Summit reached, all good. Heading down at 14:00");
+    text.add("\n\xF0\x9F\x93\x8D ").addDegrees(465401234).add(", ").addDegrees(79876543);
+    text.addf(" alt %dm, ", 3120).addTimeAgo(42000);
+}
+
+// The same through string concatenation, as the String += chains did
+static std::string renderPacketWithStrings()
+{
+    std::string name = "Base_Camp";
+    std::string msg = "\xF0\x9F\x92\xAC *" + name + "* (!a1b2c3d4)\n";
+    msg += std::string("Summit reached, all good. Heading down at 14:00");
+    msg += "\n\xF0\x9F\x93\x8D " + std::to_string(46.5401234) + ", " + std::to_string(7.9876543);
+    msg += " alt " + std::to_string(3120) + "m, " + std::to_string(42) + "s ago";
+    return msg;
+}
+
+static void test_renders_a_packet_without_the_heap(void)
+{
+    TelegramTextBuffer<384> text;
+    size_t before = allocations;
+    for (int i = 0; i < 1000; i++) {
+        text.clear();
+        renderPacket(text);
+    }
+    size_t textAllocations = allocations - before;
+
+    before = allocations;
+    for (int i = 0; i < 1000; i++) {
+        std::string msg = renderPacketWithStrings();
+        TEST_ASSERT_GREATER_THAN(0, msg.size());
+    }
+    size_t stringAllocations = allocations - before;
+
+    char line[128];
+    snprintf(line, sizeof(line), "allocations per packet: %.1f TelegramText, %.1f string concatenation",
+             textAllocations / 1000.0, stringAllocations / 1000.0);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_size_t(0, textAllocations);
+    TEST_ASSERT_FALSE(text.truncated());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_escapes_markdown_entities);
+    RUN_TEST(test_degrees_round_to_six_places);
+    RUN_TEST(test_time_ago_and_durations);
+    RUN_TEST(test_truncates_on_character_boundaries);
+    RUN_TEST(test_renders_a_packet_without_the_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,171 @@
+// TelegramWiFiLink against a scripted access point: connecting without blocking, backoff with
+// jitter while the access point is gone, attempts stalled in DHCP timing out, a refused password,
+// a dropped link retried at once, and the stale status() right after begin()
+
+#include "TelegramWiFiLink.h"
+#include <unity.h>
+
+typedef TelegramWiFiLink::State State;
+
+void setUp(void)
+{
+    WiFi.reset();
+    hostSetMillis(0);
+    randomSeed(1);
+}
+
+void tearDown(void) {}
+
+struct Run {
+    uint32_t calls = 0;
+    uint32_t maxWait = 0;
+};
+
+// Step the link the way the network task does: deliver WiFi events, call service(), sleep for
+// what it returned. Stops at until, or once the link is in state stopAt.
+static Run runUntil(TelegramWiFiLink &link, uint32_t until, State stopAt = State::IDLE)
+{
+    Run run;
+    while ((int32_t)(millis() - until) < 0) {
+        WiFi.deliverEvents();
+        uint32_t wait = link.service(millis());
+        run.calls++;
+        run.maxWait = max(run.maxWait, wait);
+        if (stopAt != State::IDLE && link.state() == stopAt) {
+            break;
+        }
+        TEST_ASSERT_GREATER_THAN_UINT32(0, wait);
+        delay(min(wait, until - millis()));
+    }
+    return run;
+}
+
+static void test_connects_without_blocking(void)
+{
+    TelegramWiFiLink link;
+    link.begin("mesh", "secret");
+    TEST_ASSERT_EQUAL(State::CONNECTING, link.state());
+    TEST_ASSERT_EQUAL_UINT32(0, millis()); // begin() returned at once
+
+    runUntil(link, 60000, State::UP);
+    TEST_ASSERT_TRUE(link.isUp());
+    TEST_ASSERT_EQUAL_UINT32(1, WiFi.begins.size());
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().connects);
+    // Association plus the settle time, give or take one poll
+    TEST_ASSERT_UINT32_WITHIN(250, 3000 + TELEGRAM_WIFI_SETTLE_MS, millis());
+    TEST_ASSERT_UINT32_WITHIN(250, 3000, link.stats().lastConnectMs);
+}
+
+static void test_backs_off_while_the_access_point_is_gone(void)
+{
+    WiFi.ap.present = false;
+    TelegramWiFiLink link;
+    link.begin("mesh", "secret");
+    Run run = runUntil(link, 600000);
+
+    // Gaps between attempts double from the minimum up to the cap, each with up to 25% jitter
+    const std::vector<uint32_t> &begins = WiFi.begins;
+    uint32_t backoff = TELEGRAM_WIFI_BACKOFF_MIN;
+    bool jittered = false;
+    for (size_t i = 1; i < begins.size(); i++) {
+        uint32_t gap = begins[i] - begins[i - 1] - WiFi.ap.associateMs;
+        TEST_ASSERT_TRUE(gap >= backoff);
+        TEST_ASSERT_TRUE(gap <= backoff + backoff / 4 + 250);
+        jittered |= gap > backoff + 250;
+        backoff = min(backoff * 2, (uint32_t)TELEGRAM_WIFI_BACKOFF_MAX);
+    }
+    TEST_ASSERT_TRUE(jittered);
+    TEST_ASSERT_TRUE(begins.size() >= 10 && begins.size() <= 15);
+    TEST_ASSERT_FALSE(link.isUp());
+
+    // Coming back is noticed by the next attempt
+    WiFi.ap.present = true;
+    runUntil(link, millis() + TELEGRAM_WIFI_BACKOFF_MAX * 5 / 4 + 10000, State::UP);
+    TEST_ASSERT_TRUE(link.isUp());
+
+    char line[160];
+    snprintf(line, sizeof(line), "10 minutes without the access point: %u attempts, %u service() calls",
+             (unsigned)begins.size(), run.calls);
+    TEST_MESSAGE(line);
+}
+
+static void test_dhcp_stall_times_out(void)
+{
+    WiFi.ap.dhcpStalls = true;
+    TelegramWiFiLink link;
+    link.begin("mesh", "secret");
+    runUntil(link, TELEGRAM_WIFI_CONNECT_TIMEOUT - 1);
+    TEST_ASSERT_EQUAL(State::CONNECTING, link.state());
+    runUntil(link, TELEGRAM_WIFI_CONNECT_TIMEOUT + 300, State::BACKOFF);
+    TEST_ASSERT_EQUAL(State::BACKOFF, link.state());
+    TEST_ASSERT_UINT32_WITHIN(250, TELEGRAM_WIFI_CONNECT_TIMEOUT, millis());
+
+    WiFi.ap.dhcpStalls = false;
+    runUntil(link, millis() + 30000, State::UP);
+    TEST_ASSERT_TRUE(link.isUp());
+    TEST_ASSERT_EQUAL_UINT32(2, link.stats().attempts);
+}
+
+static void test_refused_password_backs_off(void)
+{
+    WiFi.ap.refuses = true;
+    TelegramWiFiLink link;
+    link.begin("mesh", "wrong");
+    runUntil(link, 10000, State::BACKOFF);
+    TEST_ASSERT_EQUAL(State::BACKOFF, link.state());
+    TEST_ASSERT_UINT32_WITHIN(250, WiFi.ap.associateMs, millis()); // Not the 20 s timeout
+
+    // New credentials start over at once, without waiting out the backoff
+    WiFi.ap.refuses = false;
+    link.begin("mesh", "right");
+    TEST_ASSERT_EQUAL(State::CONNECTING, link.state());
+    runUntil(link, millis() + 10000, State::UP);
+    TEST_ASSERT_TRUE(link.isUp());
+}
+
+static void test_dropped_link_retries_at_once(void)
+{
+    TelegramWiFiLink link;
+    link.begin("mesh", "secret");
+    runUntil(link, 60000, State::UP);
+    uint32_t upAt = millis();
+
+    WiFi.dropLink();
+    runUntil(link, upAt + 1500, State::CONNECTING);
+    TEST_ASSERT_EQUAL(State::CONNECTING, link.state());
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().disconnects);
+    TEST_ASSERT_EQUAL_UINT32(2, WiFi.begins.size());
+    TEST_ASSERT_TRUE(WiFi.begins[1] - upAt <= 1000); // At the next up-poll, no backoff
+
+    runUntil(link, millis() + 10000, State::UP);
+    TEST_ASSERT_TRUE(link.isUp());
+    TEST_ASSERT_EQUAL_UINT32(2, link.stats().connects);
+}
+
+static void test_stale_status_after_begin_is_ignored(void)
+{
+    // A first attempt fails with WL_NO_SSID_AVAIL, which status() keeps reporting for a moment
+    // after the retry's begin(); that must not fail the retry
+    WiFi.ap.present = false;
+    TelegramWiFiLink link;
+    link.begin("mesh", "secret");
+    runUntil(link, 10000, State::BACKOFF);
+    WiFi.ap.present = true;
+    runUntil(link, millis() + 10000, State::CONNECTING);
+    TEST_ASSERT_EQUAL(WL_NO_SSID_AVAIL, WiFi.status());
+    runUntil(link, millis() + 10000, State::UP);
+    TEST_ASSERT_TRUE(link.isUp());
+    TEST_ASSERT_EQUAL_UINT32(2, link.stats().attempts);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_connects_without_blocking);
+    RUN_TEST(test_backs_off_while_the_access_point_is_gone);
+    RUN_TEST(test_dhcp_stall_times_out);
+    RUN_TEST(test_refused_password_backs_off);
+    RUN_TEST(test_dropped_link_retries_at_once);
+    RUN_TEST(test_stale_status_after_begin_is_ignored);
+    return UNITY_END();
+}
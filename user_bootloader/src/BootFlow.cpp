@@ -0,0 +1,85 @@
+/**
+ * @file BootFlow.cpp
+ * @brief Implementation of the user bootloader's boot decision
+ */
+
+#include "BootFlow.h"
+
+BootFlow::BootFlow(ResetKind reset, const BootHandoff *handoff, uint32_t now)
+{
+    // A record that does not check out means the RTC memory did not survive, i.e. a cold start.
+    // LAUNCHED still being set means the gateway never ran after our last launch (the second
+    // stage bootloader fell back to us), so show the splash and the error rather than loop.
+    _fast = reset != ResetKind::COLD && handoff && handoff->request == (uint8_t)BootRequest::NONE;
+    _phaseMs[(size_t)BootPhase::STARTUP] = now;
+    _phaseStart = now;
+    _phase = BootPhase::SPLASH;
+}
+
+BootAction BootFlow::step(uint32_t now, bool buttonDown)
+{
+    switch (_state) {
+    case State::START:
+        if (_fast && !buttonDown) {
+            _state = State::DONE;
+            enterPhase(BootPhase::LAUNCH, now);
+            return BootAction::LAUNCH;
+        }
+        // Held through a warm reset: whoever holds it wants the config portal
+        _fast = false;
+        _state = State::WINDOW;
+        return BootAction::SPLASH;
+
+    case State::WINDOW:
+        if (_phase != BootPhase::BUTTON) {
+            enterPhase(BootPhase::BUTTON, now);
+            _windowStart = now;
+        }
+        if (buttonDown) {
+            _pressed = true;
+        } else if (_pressed) {
+            _released = true;
+            break;
+        }
+        if (now - _windowStart < BUTTON_CHECK_TIME_MS) {
+            return BootAction::POLL_BUTTON;
+        }
+        if (_pressed) {
+            _state = State::DONE;
+            enterPhase(BootPhase::LAUNCH, now);
+            return BootAction::CONFIG_PORTAL;
+        }
+        break;
+
+    case State::DONE:
+        break;
+    }
+
+    _state = State::DONE;
+    if (_phase != BootPhase::LAUNCH) {
+        enterPhase(BootPhase::LAUNCH, now);
+    }
+    return BootAction::LAUNCH;
+}
+
+void BootFlow::enterPhase(BootPhase phase, uint32_t now)
+{
+    _phaseMs[(size_t)_phase] += now - _phaseStart;
+    _phase = phase;
+    _phaseStart = now;
+}
+
+uint32_t BootFlow::totalMs() const
+{
+    uint32_t total = 0;
+    for (size_t i = 0; i < (size_t)BootPhase::COUNT; i++) {
+        total += _phaseMs[i];
+    }
+    return total;
+}
+
+const char *BootFlow::phaseName(BootPhase phase)
+{
+    static const char *const NAMES[] = {"startup", "splash", "button", "launch"};
+    return phase < BootPhase::COUNT ? NAMES[(size_t)phase] : "?";
+}
@@ -0,0 +1,69 @@
+/**
+ * @file BootFlow.h
+ * @brief Boot decision of the user bootloader, as a state machine
+ *
+ * A cold start, or a request from the gateway in the handoff record, gets
+ * the full boot: splash, then the BOOT button window. Any other reset is a
+ * warm one and boots fast: one sample of the button and, unless it is held,
+ * straight on to the gateway with no serial wait, no splash and no window.
+ * Holding BOOT through a warm reset still gets the full boot.
+ *
+ * The flow only decides; main.cpp does the printing, the waiting and the
+ * partition switch, and feeds back the time and the button. That keeps it
+ * free of Arduino calls so it can be driven on a host with a fake clock.
+ */
+
+#pragma once
+
+#include "BootHandoff.h"
+
+#ifndef BUTTON_CHECK_TIME_MS
+#define BUTTON_CHECK_TIME_MS 3000     // Check button for 3 seconds
+#endif
+
+enum class BootAction : uint8_t {
+    SPLASH,        // Wait for serial and print the welcome message
+    POLL_BUTTON,   // Wait a poll interval, then step again
+    CONFIG_PORTAL, // Button held through the window
+    LAUNCH,        // Switch to the gateway and restart
+};
+
+enum class BootPhase : uint8_t {
+    STARTUP, // From reset to the flow being created
+    SPLASH,
+    BUTTON,
+    LAUNCH,  // Locating the gateway, otadata and the restart
+    COUNT
+};
+
+class BootFlow
+{
+  public:
+    /// handoff is nullptr if the record was not valid
+    BootFlow(ResetKind reset, const BootHandoff *handoff, uint32_t now);
+
+    /// What to do next. Call again after each action but LAUNCH and CONFIG_PORTAL.
+    BootAction step(uint32_t now, bool buttonDown);
+
+    /// Close the running phase and start phase at now
+    void enterPhase(BootPhase phase, uint32_t now);
+
+    bool fast() const { return _fast; }
+    /// The button was pressed and let go within the window
+    bool released() const { return _released; }
+    uint32_t phaseMs(BootPhase phase) const { return _phaseMs[(size_t)phase]; }
+    uint32_t totalMs() const;
+    static const char *phaseName(BootPhase phase);
+
+  private:
+    enum class State : uint8_t { START, WINDOW, DONE };
+
+    State _state = State::START;
+    bool _fast;
+    bool _pressed = false;
+    bool _released = false;
+    uint32_t _windowStart = 0;
+    BootPhase _phase = BootPhase::STARTUP;
+    uint32_t _phaseStart = 0;
+    uint32_t _phaseMs[(size_t)BootPhase::COUNT] = {};
+};
@@ -0,0 +1,149 @@
+/**
+ * @file BootHandoff.h
+ * @brief Record the user bootloader and the gateway leave each other in RTC memory
+ *
+ * Every boot used to go through the user bootloader: splash, a 3 s BOOT
+ * button window, an otadata write to OTA_1 and a restart, after which the
+ * gateway wrote otadata back to OTA_0. A watchdog reset cost two restarts,
+ * two otadata writes and several seconds before the radio was back.
+ *
+ * The gateway now leaves otadata on itself, so a software, panic or
+ * watchdog reset restarts it directly. Only a cold start needs the user
+ * bootloader, and the two firmwares tell a cold start from a warm one with
+ * this record: the ESP32 keeps RTC slow memory through every reset except
+ * a power cycle, so a record with the right magic and checksum survives
+ * warm resets and reads as garbage after power-on. A gateway that comes
+ * up cold points otadata at the user bootloader, asks it here for the
+ * splash and the button window, and restarts.
+ *
+ * Both firmwares map the record at the same fixed address, the top of RTC
+ * slow memory, because each places its own RTC variables differently. The
+ * gateway build reaches this header through -I ../../user_bootloader/src.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef ESP_PLATFORM
+#include "esp_system.h"
+#endif
+
+#define BOOT_HANDOFF_MAGIC 0x4D474231 // "MGB1"; change it whenever the layout changes
+#define BOOT_RTC_SLOW_END 0x50002000  // RTC slow memory is 0x50000000-0x50001FFF
+
+#ifndef BOOT_CRASH_RESETS_MAX
+#define BOOT_CRASH_RESETS_MAX 5       // Gateway crashes in a row before the user bootloader gets a turn
+#endif
+#ifndef BOOT_HEALTHY_MS
+#define BOOT_HEALTHY_MS 60000         // Gateway uptime after which its crash count is cleared
+#endif
+
+enum class ResetKind : uint8_t {
+    COLD,  // Power-on, brownout, or a reason we do not know
+    SOFT,  // esp_restart() or a deep-sleep wake
+    CRASH, // Panic or any of the watchdogs
+};
+
+#ifdef ESP_PLATFORM
+inline ResetKind bootResetKind(esp_reset_reason_t reason)
+{
+    switch (reason) {
+    case ESP_RST_SW:
+    case ESP_RST_DEEPSLEEP:
+        return ResetKind::SOFT;
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+        return ResetKind::CRASH;
+    default:
+        // The EN pin also reads as a power-on reset on the ESP32
+        return ResetKind::COLD;
+    }
+}
+#endif
+
+enum class BootRequest : uint8_t {
+    NONE,
+    FULL,     // Gateway came up cold: show the splash and the BOOT button window
+    RESCUE,   // Gateway kept crashing: the same, so the config portal stays reachable
+    LAUNCHED, // User bootloader has just started the gateway
+};
+
+struct BootHandoff {
+    uint32_t magic;
+    uint8_t request;        // BootRequest
+    uint8_t crashResets;    // Gateway crash resets in a row
+    uint16_t loaderMs;      // Time the user bootloader took before its restart
+    uint32_t otadataWrites; // Since power-on, by both firmwares
+    uint32_t warmBoots;     // Gateway boots that skipped the user bootloader, since power-on
+    uint32_t checksum;
+};
+
+/// The record in RTC slow memory; only meaningful on the ESP32
+inline BootHandoff &bootHandoff()
+{
+    return *reinterpret_cast<BootHandoff *>(BOOT_RTC_SLOW_END - sizeof(BootHandoff));
+}
+
+inline uint32_t bootHandoffChecksum(const BootHandoff &h)
+{
+    // FNV-1a over everything but the checksum
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&h);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(BootHandoff, checksum); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+inline bool bootHandoffValid(const BootHandoff &h)
+{
+    return h.magic == BOOT_HANDOFF_MAGIC && h.checksum == bootHandoffChecksum(h);
+}
+
+/// Call after every change, or the other side reads the record as garbage
+inline void bootHandoffSeal(BootHandoff &h)
+{
+    h.magic = BOOT_HANDOFF_MAGIC;
+    h.checksum = bootHandoffChecksum(h);
+}
+
+/// Start over after a power cycle
+inline void bootHandoffClear(BootHandoff &h)
+{
+    h = BootHandoff();
+    bootHandoffSeal(h);
+}
+
+enum class GatewayBoot : uint8_t {
+    RUN,       // Carry on, otadata stays on the gateway
+    TO_LOADER, // Point otadata at the user bootloader and restart
+};
+
+/**
+ * What the gateway does first thing at startup. Updates the record, which
+ * the caller seals; for TO_LOADER the caller also switches otadata and
+ * restarts.
+ */
+inline GatewayBoot gatewayBootAction(BootHandoff &h, ResetKind reset)
+{
+    if (reset == ResetKind::COLD || !bootHandoffValid(h)) {
+        bootHandoffClear(h);
+        h.request = (uint8_t)BootRequest::FULL;
+        return GatewayBoot::TO_LOADER;
+    }
+    if (h.request == (uint8_t)BootRequest::LAUNCHED) {
+        // The user bootloader started us; its restart is not a crash of ours
+        h.request = (uint8_t)BootRequest::NONE;
+        return GatewayBoot::RUN;
+    }
+    h.warmBoots++;
+    if (reset == ResetKind::CRASH && ++h.crashResets >= BOOT_CRASH_RESETS_MAX) {
+        h.crashResets = 0;
+        h.request = (uint8_t)BootRequest::RESCUE;
+        return GatewayBoot::TO_LOADER;
+    }
+    return GatewayBoot::RUN;
+}
@@ -2,7 +2,7 @@
  * @file main.cpp
  * @brief User Bootloader for Meshtastic-Telegram Gateway
  * 
- * This firmware runs on every power-on, displays a welcome message,
+ * This firmware runs on every cold start, displays a welcome message,
  * and then boots the Gateway firmware from OTA_1.
  * 
  * Features:
@@ -11,6 +11,8 @@
  * - BOOT button (hold 3s) → WiFi AP + Web Config Portal
  * - Saves WiFi/Telegram/LoRa config to NVS
  * - Automatically boots Gateway firmware
+ * - Warm resets boot straight through, without splash or button window
+ *   (see BootFlow.h and BootHandoff.h)
  * 
  * Size: ~150KB (fits in 960KB OTA_0 partition)
  */
@@ -21,6 +23,8 @@
 #include <Preferences.h>
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
+#include "esp_system.h"
+#include "BootFlow.h"
 
 // Version information
 #define BOOTLOADER_VERSION "1.1.0"
@@ -36,8 +40,8 @@
 
 // Timing
 #define MESSAGE_DISPLAY_TIME_MS 2000  // Show message for 2 seconds
-#define BUTTON_CHECK_TIME_MS 3000     // Check button for 3 seconds
 #define BUTTON_POLL_INTERVAL_MS 50    // Check button every 50ms
+#define BUTTON_DOT_INTERVAL_MS 500    // Progress dot while the button is held
 
 // Config AP settings
 #define CONFIG_AP_SSID "MG-Config"
@@ -485,48 +489,20 @@ void startConfigPortal() {
 }
 
 // ============================================================================
-// BUTTON DETECTION
+// GATEWAY BOOT FUNCTIONS
 // ============================================================================
 
-bool checkBootButton() {
-    Serial.println("🔘 Checking BOOT button (hold for 3s to enter Config Mode)...");
-    
-    unsigned long startTime = millis();
-    bool buttonPressed = false;
-    int dotCount = 0;
-    
-    while (millis() - startTime < BUTTON_CHECK_TIME_MS) {
-        if (digitalRead(BOOT_BUTTON_PIN) == LOW) {
-            buttonPressed = true;
-            
-            // Print progress dots
-            if ((millis() - startTime) % 500 == 0 && dotCount < 6) {
-                Serial.print(".");
-                dotCount++;
-            }
-        } else {
-            if (buttonPressed) {
-                Serial.println(" Released\n");
-                return false;
-            }
-        }
-        delay(BUTTON_POLL_INTERVAL_MS);
-    }
-    
-    if (buttonPressed) {
-        Serial.println(" ✅ Held!\n");
-        return true;
+void printBootPhases(const BootFlow& flow, const BootHandoff& handoff) {
+    Serial.print("⏱️  Boot phases:");
+    for (size_t i = 0; i < (size_t)BootPhase::COUNT; i++) {
+        Serial.printf(" %s %u ms%s", BootFlow::phaseName((BootPhase)i), flow.phaseMs((BootPhase)i),
+                      i + 1 < (size_t)BootPhase::COUNT ? "," : "");
     }
-    
-    Serial.println(" Not pressed\n");
-    return false;
+    Serial.printf(" (%u ms, %s boot, %u otadata write(s) since power-on)\n", flow.totalMs(),
+                  flow.fast() ? "fast" : "full", handoff.otadataWrites);
 }
 
-// ============================================================================
-// GATEWAY BOOT FUNCTIONS
-// ============================================================================
-
-void bootGatewayFirmware() {
+void bootGatewayFirmware(BootFlow& flow) {
     // Find OTA_1 partition (Gateway firmware)
     const esp_partition_t* gateway = esp_partition_find_first(
         ESP_PARTITION_TYPE_APP,
@@ -553,29 +529,44 @@ void bootGatewayFirmware() {
         return;
     }
     
-    Serial.println("  [2/3] Locating Gateway firmware...      ✅");
-    
-    // Verify partition is valid
-    if (gateway->size < MIN_GATEWAY_SIZE_BYTES) {
-        Serial.println("  [3/3] Validating firmware...            ⚠️");
-        Serial.println();
-        Serial.printf("Warning: Gateway partition is %d bytes (expected >%d bytes).\n", 
-                      gateway->size, MIN_GATEWAY_SIZE_BYTES);
-        Serial.println("Partition may be empty or corrupted.");
-        Serial.println("Attempting to boot anyway...");
-        Serial.println();
+    BootHandoff& handoff = bootHandoff();
+    if (flow.fast()) {
+        // Warm reset: nothing to show, nobody waiting at the button, and the partition was
+        // validated on the cold start
+        Serial.println("⚡ Warm reset - fast boot into Gateway");
     } else {
-        Serial.println("  [3/3] Validating firmware...            ✅");
+        Serial.println("  [2/3] Locating Gateway firmware...      ✅");
+        
+        // Verify partition is valid
+        if (gateway->size < MIN_GATEWAY_SIZE_BYTES) {
+            Serial.println("  [3/3] Validating firmware...            ⚠️");
+            Serial.println();
+            Serial.printf("Warning: Gateway partition is %d bytes (expected >%d bytes).\n", 
+                          gateway->size, MIN_GATEWAY_SIZE_BYTES);
+            Serial.println("Partition may be empty or corrupted.");
+            Serial.println("Attempting to boot anyway...");
+            Serial.println();
+        } else {
+            Serial.println("  [3/3] Validating firmware...            ✅");
+            Serial.println();
+        }
+        
+        Serial.printf("Gateway Partition Info:\n");
+        Serial.printf("  - Address: 0x%X\n", gateway->address);
+        Serial.printf("  - Size:    %d bytes (%.2f MB)\n", gateway->size, gateway->size / 1024.0 / 1024.0);
         Serial.println();
     }
     
-    Serial.printf("Gateway Partition Info:\n");
-    Serial.printf("  - Address: 0x%X\n", gateway->address);
-    Serial.printf("  - Size:    %d bytes (%.2f MB)\n", gateway->size, gateway->size / 1024.0 / 1024.0);
-    Serial.println();
-    
-    // Set OTA_1 as boot partition
-    esp_err_t err = esp_ota_set_boot_partition(gateway);
+    // Set OTA_1 as boot partition, unless otadata already says so: every write erases a
+    // flash sector of the otadata partition
+    const esp_partition_t* current = esp_ota_get_boot_partition();
+    esp_err_t err = ESP_OK;
+    if (!current || current->address != gateway->address) {
+        err = esp_ota_set_boot_partition(gateway);
+        if (err == ESP_OK) {
+            handoff.otadataWrites++;
+        }
+    }
     if (err != ESP_OK) {
         Serial.println("❌ Failed to set boot partition!");
         Serial.printf("   Error code: 0x%X\n", err);
@@ -586,14 +577,22 @@ void bootGatewayFirmware() {
         return;
     }
     
-    Serial.println("✅ Boot partition set successfully!");
-    Serial.println();
-    Serial.println("╔════════════════════════════════════════════════════════╗");
-    Serial.println("║         Launching Gateway Firmware...                 ║");
-    Serial.println("╚════════════════════════════════════════════════════════╝");
-    Serial.println();
+    if (!flow.fast()) {
+        Serial.println("✅ Boot partition set successfully!");
+        Serial.println();
+        Serial.println("╔════════════════════════════════════════════════════════╗");
+        Serial.println("║         Launching Gateway Firmware...                 ║");
+        Serial.println("╚════════════════════════════════════════════════════════╝");
+        Serial.println();
+    }
     
-    delay(1000);
+    // Tell the gateway it was us, so it neither counts our restart as a crash nor bounces back
+    flow.enterPhase(BootPhase::LAUNCH, millis());
+    handoff.request = (uint8_t)BootRequest::LAUNCHED;
+    handoff.loaderMs = flow.totalMs() > UINT16_MAX ? UINT16_MAX : flow.totalMs();
+    bootHandoffSeal(handoff);
+    printBootPhases(flow, handoff);
+    Serial.flush();
     
     // Restart into Gateway firmware
     ESP.restart();
@@ -606,29 +605,57 @@ void bootGatewayFirmware() {
 void setup() {
     // Initialize serial
     Serial.begin(SERIAL_BAUD);
-    delay(500);  // Wait for serial to stabilize
     
     // Initialize button pin
     pinMode(BOOT_BUTTON_PIN, INPUT_PULLUP);
     
-    // Print welcome message
-    printWelcomeMessage();
-    
-    // Check for config mode (button held)
-    if (checkBootButton()) {
-        startConfigPortal();
-        // Never returns (reboots after config)
+    // Cold start or warm reset? See BootHandoff.h
+    BootHandoff& handoff = bootHandoff();
+    bool valid = bootHandoffValid(handoff);
+    BootFlow flow(bootResetKind(esp_reset_reason()), valid ? &handoff : nullptr, millis());
+    if (!valid) {
+        bootHandoffClear(handoff);
     }
+    // Consumed: a restart from the config portal or after an error boots fast
+    handoff.request = (uint8_t)BootRequest::NONE;
+    bootHandoffSeal(handoff);
     
-    // Normal boot sequence - button check already took 3 seconds
-    // No additional delay needed (button check > message display time)
-    
-    // Print boot sequence
-    printBootMessage();
-    delay(500);
-    
-    // Boot Gateway firmware
-    bootGatewayFirmware();
+    unsigned long lastDot = 0;
+    while (true) {
+        bool buttonDown = digitalRead(BOOT_BUTTON_PIN) == LOW;
+        switch (flow.step(millis(), buttonDown)) {
+        case BootAction::SPLASH:
+            delay(500);  // Wait for serial to stabilize
+            printWelcomeMessage();
+            Serial.println("🔘 Checking BOOT button (hold for 3s to enter Config Mode)...");
+            break;
+            
+        case BootAction::POLL_BUTTON:
+            if (buttonDown && millis() - lastDot >= BUTTON_DOT_INTERVAL_MS) {
+                Serial.print(".");
+                lastDot = millis();
+            }
+            delay(BUTTON_POLL_INTERVAL_MS);
+            break;
+            
+        case BootAction::CONFIG_PORTAL:
+            Serial.println(" ✅ Held!\n");
+            startConfigPortal();
+            // Never returns (reboots after config)
+            return;
+            
+        case BootAction::LAUNCH:
+            if (!flow.fast()) {
+                Serial.println(flow.released() ? " Released\n" : " Not pressed\n");
+                // Print boot sequence
+                printBootMessage();
+                delay(500);
+            }
+            // Boot Gateway firmware
+            bootGatewayFirmware(flow);
+            return;
+        }
+    }
 }
 
 void loop() {
@@ -0,0 +1,322 @@
+// Boot decision of the user bootloader and the gateway's half of the handoff: a warm reset back
+// in the gateway within its time budget, cold starts and bad records taking the full path, the
+// BOOT button window to the millisecond, press-and-release against a hold, the crash-loop rescue
+// and the fallback when the gateway never ran
+//
+// Device below mirrors the user bootloader's setup() and bootGatewayFirmware() and the start of
+// the gateway's setup(), with delays that advance a fake clock instead of waiting.
+
+#include "BootFlow.h"
+#include <cstring>
+#include <initializer_list>
+#include <unity.h>
+
+#define ROM_MS 280          // ROM, second stage bootloader and app init, per restart
+#define GATEWAY_TOP_MS 30   // Gateway startup to the top of setup()
+#define SPLASH_MS 520       // Serial wait and welcome message
+#define POLL_MS 50          // BUTTON_POLL_INTERVAL_MS in main.cpp
+#define BOOT_MESSAGE_MS 500 // printBootMessage() and its delay
+#define WARM_BUDGET_MS 400  // Reset to gateway setup() for a warm reset
+
+enum Partition { LOADER, GATEWAY };
+
+struct Boot {
+    uint32_t ms = 0;        // Reset to the gateway's setup(), or to the config portal
+    uint32_t restarts = 0;
+    uint32_t writes = 0;    // otadata writes
+    bool full = false;      // Splash and button window shown
+    bool portal = false;
+};
+
+struct Device {
+    BootHandoff rtc;        // Stands in for RTC slow memory
+    Partition otadata = LOADER;
+    uint32_t writes = 0;
+
+    Device() { powerCycle(); }
+
+    // RTC slow memory comes up as garbage
+    void powerCycle() { memset(&rtc, 0xA5, sizeof(rtc)); }
+
+    void setBoot(Partition partition)
+    {
+        if (otadata != partition) {
+            otadata = partition;
+            writes++;
+            rtc.otadataWrites++;
+        }
+    }
+
+    // The user bootloader from reset to LAUNCH or CONFIG_PORTAL; true if it launched
+    bool loader(ResetKind reset, bool button, Boot &boot)
+    {
+        bool valid = bootHandoffValid(rtc);
+        BootFlow flow(reset, valid ? &rtc : nullptr, 0);
+        if (!valid) {
+            bootHandoffClear(rtc);
+        }
+        rtc.request = (uint8_t)BootRequest::NONE;
+        bootHandoffSeal(rtc);
+
+        uint32_t now = 0;
+        for (;;) {
+            switch (flow.step(now, button)) {
+            case BootAction::SPLASH:
+                now += SPLASH_MS;
+                break;
+            case BootAction::POLL_BUTTON:
+                now += POLL_MS;
+                break;
+            case BootAction::CONFIG_PORTAL:
+                boot.ms += now;
+                boot.full = boot.portal = true;
+                return false;
+            case BootAction::LAUNCH:
+                if (!flow.fast()) {
+                    now += BOOT_MESSAGE_MS;
+                }
+                setBoot(GATEWAY);
+                flow.enterPhase(BootPhase::LAUNCH, now);
+                rtc.request = (uint8_t)BootRequest::LAUNCHED;
+                rtc.loaderMs = flow.totalMs();
+                bootHandoffSeal(rtc);
+                boot.ms += now;
+                boot.full |= !flow.fast();
+                return true;
+            }
+        }
+    }
+
+    // A reset until the gateway runs or the config portal is up
+    Boot reset(ResetKind kind, bool button = false)
+    {
+        Boot boot;
+        uint32_t writesBefore = writes;
+        for (int restarts = 0; restarts < 4; restarts++) {
+            boot.ms += ROM_MS;
+            if (otadata == LOADER) {
+                if (!loader(kind, button, boot)) {
+                    break;
+                }
+            } else {
+                boot.ms += GATEWAY_TOP_MS;
+                GatewayBoot action = gatewayBootAction(rtc, kind);
+                if (action == GatewayBoot::TO_LOADER) {
+                    setBoot(LOADER);
+                }
+                bootHandoffSeal(rtc);
+                if (action == GatewayBoot::RUN) {
+                    break;
+                }
+            }
+            boot.restarts++;
+            kind = ResetKind::SOFT;
+        }
+        boot.writes = writes - writesBefore;
+        return boot;
+    }
+};
+
+static Device *device;
+
+void setUp(void)
+{
+    device = new Device();
+}
+
+void tearDown(void)
+{
+    delete device;
+}
+
+// From power-on to the gateway running, then healthy
+static void bootToGateway()
+{
+    device->reset(ResetKind::COLD);
+    device->rtc.crashResets = 0;
+    bootHandoffSeal(device->rtc);
+}
+
+static void test_warm_reset_launches_within_budget(void)
+{
+    bootToGateway();
+    for (ResetKind kind : {ResetKind::SOFT, ResetKind::CRASH}) {
+        Boot boot = device->reset(kind);
+        TEST_ASSERT_FALSE(boot.full);
+        TEST_ASSERT_EQUAL_UINT32(0, boot.restarts);
+        TEST_ASSERT_EQUAL_UINT32(0, boot.writes);
+        TEST_ASSERT_TRUE(boot.ms <= WARM_BUDGET_MS);
+    }
+
+    // The user bootloader itself, restarted warm from the config portal: one step to LAUNCH
+    BootHandoff handoff;
+    bootHandoffClear(handoff);
+    BootFlow flow(ResetKind::SOFT, &handoff, 40);
+    TEST_ASSERT_TRUE(flow.fast());
+    TEST_ASSERT_EQUAL(BootAction::LAUNCH, flow.step(41, false));
+    flow.enterPhase(BootPhase::LAUNCH, 45);
+    TEST_ASSERT_EQUAL_UINT32(0, flow.phaseMs(BootPhase::BUTTON));
+    TEST_ASSERT_EQUAL_UINT32(45, flow.totalMs());
+
+    char line[128];
+    Boot boot = device->reset(ResetKind::CRASH);
+    snprintf(line, sizeof(line), "watchdog reset: %u ms to gateway setup(), %u restarts, %u otadata writes", boot.ms,
+             boot.restarts, boot.writes);
+    TEST_MESSAGE(line);
+}
+
+static void test_cold_start_or_bad_record_takes_the_full_path(void)
+{
+    // First boot after flashing: otadata erased, so the user bootloader comes up first
+    Boot boot = device->reset(ResetKind::COLD);
+    TEST_ASSERT_TRUE(boot.full);
+    TEST_ASSERT_EQUAL_UINT32(1, boot.restarts);
+    TEST_ASSERT_EQUAL_UINT32(1, boot.writes);
+
+    // Power cycle with otadata on the gateway: it hands back to the user bootloader
+    device->powerCycle();
+    boot = device->reset(ResetKind::COLD);
+    TEST_ASSERT_TRUE(boot.full);
+    TEST_ASSERT_EQUAL_UINT32(2, boot.restarts);
+    TEST_ASSERT_EQUAL_UINT32(2, boot.writes);
+    TEST_ASSERT_EQUAL_UINT32(2, device->rtc.otadataWrites);
+
+    // A record that is intact says warm, but a cold reset kind wins
+    BootHandoff handoff;
+    bootHandoffClear(handoff);
+    TEST_ASSERT_FALSE(BootFlow(ResetKind::COLD, &handoff, 0).fast());
+    // A warm reset with a record that does not check out
+    TEST_ASSERT_FALSE(BootFlow(ResetKind::SOFT, nullptr, 0).fast());
+    handoff.warmBoots++; // Changed but not sealed
+    TEST_ASSERT_FALSE(bootHandoffValid(handoff));
+    TEST_ASSERT_EQUAL(GatewayBoot::TO_LOADER, gatewayBootAction(handoff, ResetKind::CRASH));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)BootRequest::FULL, handoff.request);
+    TEST_ASSERT_EQUAL_UINT32(0, handoff.warmBoots);
+    // A pending request from the gateway
+    for (BootRequest request : {BootRequest::FULL, BootRequest::RESCUE}) {
+        handoff.request = (uint8_t)request;
+        TEST_ASSERT_FALSE(BootFlow(ResetKind::SOFT, &handoff, 0).fast());
+    }
+}
+
+static void test_window_is_exactly_button_check_time(void)
+{
+    BootFlow flow(ResetKind::COLD, nullptr, 40);
+    TEST_ASSERT_EQUAL(BootAction::SPLASH, flow.step(40, false));
+    const uint32_t opened = 40 + SPLASH_MS;
+    uint32_t now = opened;
+    uint32_t polls = 0;
+    BootAction action;
+    while ((action = flow.step(now, false)) == BootAction::POLL_BUTTON) {
+        now += POLL_MS;
+        polls++;
+    }
+    TEST_ASSERT_EQUAL(BootAction::LAUNCH, action);
+    TEST_ASSERT_EQUAL_UINT32(BUTTON_CHECK_TIME_MS, now - opened);
+    TEST_ASSERT_EQUAL_UINT32(BUTTON_CHECK_TIME_MS / POLL_MS, polls);
+    TEST_ASSERT_FALSE(flow.released());
+
+    flow.enterPhase(BootPhase::LAUNCH, now + 25);
+    TEST_ASSERT_EQUAL_UINT32(40, flow.phaseMs(BootPhase::STARTUP));
+    TEST_ASSERT_EQUAL_UINT32(SPLASH_MS, flow.phaseMs(BootPhase::SPLASH));
+    TEST_ASSERT_EQUAL_UINT32(BUTTON_CHECK_TIME_MS, flow.phaseMs(BootPhase::BUTTON));
+    TEST_ASSERT_EQUAL_UINT32(25, flow.phaseMs(BootPhase::LAUNCH));
+    TEST_ASSERT_EQUAL_UINT32(now + 25, flow.totalMs());
+
+    // Held down one poll short of the window, then let go: not a hold
+    BootFlow late(ResetKind::COLD, nullptr, 0);
+    late.step(0, false);
+    for (now = 0; now < BUTTON_CHECK_TIME_MS; now += POLL_MS) {
+        TEST_ASSERT_EQUAL(BootAction::POLL_BUTTON, late.step(now, true));
+    }
+    TEST_ASSERT_EQUAL(BootAction::LAUNCH, late.step(now, false));
+    TEST_ASSERT_TRUE(late.released());
+}
+
+static void test_press_and_release_against_hold(void)
+{
+    BootFlow tap(ResetKind::COLD, nullptr, 0);
+    tap.step(0, false);
+    TEST_ASSERT_EQUAL(BootAction::POLL_BUTTON, tap.step(500, true));
+    TEST_ASSERT_EQUAL(BootAction::POLL_BUTTON, tap.step(550, true));
+    // Let go well inside the window: launch at once rather than wait it out
+    TEST_ASSERT_EQUAL(BootAction::LAUNCH, tap.step(600, false));
+    TEST_ASSERT_TRUE(tap.released());
+    TEST_ASSERT_EQUAL(BootAction::LAUNCH, tap.step(650, true));
+
+    BootFlow hold(ResetKind::COLD, nullptr, 0);
+    hold.step(0, false);
+    uint32_t now = 500;
+    BootAction action;
+    while ((action = hold.step(now, true)) == BootAction::POLL_BUTTON) {
+        now += POLL_MS;
+    }
+    TEST_ASSERT_EQUAL(BootAction::CONFIG_PORTAL, action);
+    TEST_ASSERT_EQUAL_UINT32(500 + BUTTON_CHECK_TIME_MS, now);
+    TEST_ASSERT_FALSE(hold.released());
+
+    // Held through a warm reset: the full path and the portal, with no otadata write
+    bootToGateway();
+    device->setBoot(LOADER);
+    uint32_t writes = device->writes;
+    Boot boot = device->reset(ResetKind::SOFT, true);
+    TEST_ASSERT_TRUE(boot.portal);
+    TEST_ASSERT_EQUAL_UINT32(writes, device->writes);
+}
+
+static void test_crash_loop_hands_over_at_the_limit(void)
+{
+    bootToGateway();
+    uint32_t warmBoots = device->rtc.warmBoots;
+    for (int crash = 1; crash < BOOT_CRASH_RESETS_MAX; crash++) {
+        Boot boot = device->reset(ResetKind::CRASH);
+        TEST_ASSERT_FALSE(boot.full);
+        TEST_ASSERT_EQUAL_UINT8(crash, device->rtc.crashResets);
+    }
+    Boot boot = device->reset(ResetKind::CRASH);
+    TEST_ASSERT_TRUE(boot.full);
+    TEST_ASSERT_EQUAL_UINT32(2, boot.restarts);
+    TEST_ASSERT_EQUAL_UINT8(0, device->rtc.crashResets);
+    TEST_ASSERT_EQUAL_UINT32(warmBoots + BOOT_CRASH_RESETS_MAX, device->rtc.warmBoots);
+
+    // Soft resets in between neither count nor clear the count; the user bootloader's own
+    // restart is not a crash either
+    bootToGateway();
+    for (int i = 0; i < 2 * (BOOT_CRASH_RESETS_MAX - 1); i++) {
+        TEST_ASSERT_FALSE(device->reset(i % 2 ? ResetKind::SOFT : ResetKind::CRASH).full);
+    }
+    TEST_ASSERT_EQUAL_UINT8(BOOT_CRASH_RESETS_MAX - 1, device->rtc.crashResets);
+    TEST_ASSERT_TRUE(device->reset(ResetKind::CRASH).full);
+}
+
+static void test_launched_record_falls_back_to_the_full_path(void)
+{
+    // The user bootloader launched the gateway, but the second stage bootloader came back to it
+    // with otadata still on the gateway: the splash and the error, not a silent loop
+    bootToGateway();
+    device->rtc.request = (uint8_t)BootRequest::LAUNCHED;
+    bootHandoffSeal(device->rtc);
+    uint32_t writes = device->writes;
+    Boot boot;
+    TEST_ASSERT_TRUE(device->loader(ResetKind::SOFT, false, boot));
+    TEST_ASSERT_TRUE(boot.full);
+    TEST_ASSERT_EQUAL_UINT32(writes, device->writes);
+
+    // The gateway that did come up clears it and runs, without counting a warm boot
+    uint32_t warmBoots = device->rtc.warmBoots;
+    TEST_ASSERT_EQUAL(GatewayBoot::RUN, gatewayBootAction(device->rtc, ResetKind::SOFT));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)BootRequest::NONE, device->rtc.request);
+    TEST_ASSERT_EQUAL_UINT32(warmBoots, device->rtc.warmBoots);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_warm_reset_launches_within_budget);
+    RUN_TEST(test_cold_start_or_bad_record_takes_the_full_path);
+    RUN_TEST(test_window_is_exactly_button_check_time);
+    RUN_TEST(test_press_and_release_against_hold);
+    RUN_TEST(test_crash_loop_hands_over_at_the_limit);
+    RUN_TEST(test_launched_record_falls_back_to_the_full_path);
+    return UNITY_END();
+}